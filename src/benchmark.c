@@ -0,0 +1,1579 @@
+/*
+ * This file is part of ui-tests
+ *
+ * Copyright © 2016-2017 Ikey Doherty <ikey@solus-project.com>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ */
+
+#include "util.h"
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+BUDGIE_BEGIN_PEDANTIC
+#include "benchmark.h"
+#include "geometry-cache.h"
+#include "monitor-cache.h"
+#include "popover-manager.h"
+#include "popover-placement.h"
+#include "popover-shadow.h"
+#include "popover.h"
+#include <gtk/gtk.h>
+BUDGIE_END_PEDANTIC
+
+/**
+ * Buttons per row of the fake panel, keeping 500 of them on a 1920x1080
+ * virtual screen
+ */
+#define BENCHMARK_COLUMNS 25
+
+/**
+ * Milliseconds to let the display settle before the first and between each
+ * subsequent step
+ */
+#define BENCHMARK_STARTUP_MS 500
+#define BENCHMARK_SETTLE_MS 50
+
+/**
+ * Milliseconds after which a step that never completed counts as a failure
+ */
+#define BENCHMARK_STEP_TIMEOUT_MS 2000
+
+/**
+ * A mean that is this much slower than the baseline counts as a regression
+ */
+#define BENCHMARK_TOLERANCE 1.25
+
+/**
+ * Frame budget in microseconds when the monitor doesn't report its refresh
+ * rate, as is the case under Xvfb: one frame at 60Hz
+ */
+#define BENCHMARK_FRAME_BUDGET_US 16667
+
+/**
+ * Number of popovers alive at any one time during the churn run
+ */
+#define CHURN_SLOTS 64
+
+/**
+ * Size of the mask blurred by the blur benchmark, about that of a full
+ * popover surface, and the box radii it is blurred with
+ */
+#define BLUR_WIDTH 320
+#define BLUR_HEIGHT 240
+static const gint blur_radii[] = { 1, 2, 4, 8, 16 };
+
+/**
+ * Registration counts measured by the dispatch benchmark, and the number of
+ * crossing events timed at each
+ */
+static const guint dispatch_sizes[] = { 10, 100, 1000 };
+#define DISPATCH_EVENTS 10000
+
+/**
+ * Registration counts measured by the lookup benchmark, and the number of
+ * random points looked up at each
+ */
+static const guint lookup_sizes[] = { 2, 10, 100, 1000 };
+#define LOOKUP_QUERIES 100000
+
+/**
+ * Most synthetic monitors laid side by side by the monitor benchmark, the
+ * size of each, and the number of placements timed per layout
+ */
+#define MONITORS_MAX 8
+#define MONITORS_WIDTH 1920
+#define MONITORS_HEIGHT 1080
+#define MONITORS_PLACEMENTS 100000
+
+/**
+ * Resident memory the churn run may gain after warming up, in kilobytes
+ */
+#define CHURN_RSS_SLACK 4096
+
+typedef enum {
+        CHURN_REGISTER = 0,
+        CHURN_SHOW,
+        CHURN_DESTROY_WIDGET,  /* Popover goes down with its relative-to widget */
+        CHURN_DESTROY_POPOVER, /* Popover goes away while still registered */
+        CHURN_UNREGISTER,
+        CHURN_TIMEOUT, /* Factory content expires after a second, or never */
+        CHURN_N_OPERATIONS,
+} BudgieChurnOperation;
+
+/**
+ * What an empty slot is filled with, picked by the operation that hit it
+ */
+typedef enum {
+        CHURN_KIND_POPOVER = 0, /* Its own popover */
+        CHURN_KIND_CONTENT,     /* Content shown in the manager's shared popover */
+        CHURN_KIND_FACTORY,     /* As above, but only built when shown */
+        CHURN_N_KINDS,
+} BudgieChurnKind;
+
+typedef struct BudgieChurnSlot {
+        GtkWidget *button;
+        GtkWidget *popover; /* NULL unless registered with its own popover */
+        BudgieChurnKind kind;
+} BudgieChurnSlot;
+
+typedef enum {
+        BENCHMARK_STEP_OPEN = 0, /* Click a button, wait for the popover to draw */
+        BENCHMARK_STEP_ROLLOVER, /* Move to the neighbour, wait for its popover to draw */
+        BENCHMARK_STEP_REVEAL,   /* Toggle its revealer, wait for the animation to end */
+        BENCHMARK_STEP_CLOSE,    /* Press Escape, wait for the popover to unmap */
+        BENCHMARK_STEP_DONE,
+} BudgieBenchmarkStep;
+
+typedef struct BudgieBenchmarkSample {
+        guint count;
+        gint64 total;
+        gint64 max;
+} BudgieBenchmarkSample;
+
+typedef struct BudgieBenchmark {
+        BudgiePopoverManager *manager;
+        GtkWidget *window;
+        GPtrArray *buttons;
+        GPtrArray *popovers;
+        GPtrArray *revealers; /* One inside of each popover, as in the demo */
+        guint iterations;
+        guint iteration;
+        BudgieBenchmarkStep step;
+        GtkWidget *target; /* Popover we're waiting on for the current step */
+        gint64 start;
+        guint timeout_source;
+        BudgieBenchmarkSample open;
+        BudgieBenchmarkSample rollover;
+        BudgieBenchmarkSample close;
+        BudgieBenchmarkSample reveal;
+        guint64 reveal_redraws; /* Redraws of the target popover while revealing */
+        guint64 reveal_pixels;
+        guint64 reveal_from_redraws; /* Its counters as the current animation started */
+        guint64 reveal_from_pixels;
+        BudgieBenchmarkSample backing; /* Bytes of window surface per open popover */
+        guint64 frames;
+        guint failures;
+        gint64 frame_budget; /* Microseconds per frame on the panel's monitor */
+        guint over_budget;   /* Roll-overs that took longer than a frame */
+} BudgieBenchmark;
+
+static gboolean budgie_benchmark_next(gpointer v);
+
+static void budgie_benchmark_sample_add(BudgieBenchmarkSample *sample, gint64 usec)
+{
+        sample->count++;
+        sample->total += usec;
+        sample->max = MAX(sample->max, usec);
+}
+
+static gint64 budgie_benchmark_sample_mean(BudgieBenchmarkSample *sample)
+{
+        return sample->count > 0 ? sample->total / sample->count : 0;
+}
+
+static gint64 budgie_benchmark_histogram_mean(const BudgieHistogram *histogram)
+{
+        return histogram->count > 0 ? histogram->total / (gint64)histogram->count : 0;
+}
+
+/**
+ * Work out where the centre of @widget is, relative to its toplevel window
+ */
+static void budgie_benchmark_widget_centre(GtkWidget *widget, gint *x, gint *y)
+{
+        GtkAllocation alloc = { 0 };
+
+        gtk_widget_get_allocation(widget, &alloc);
+        gtk_widget_translate_coordinates(widget,
+                                         gtk_widget_get_toplevel(widget),
+                                         alloc.width / 2,
+                                         alloc.height / 2,
+                                         x,
+                                         y);
+}
+
+/**
+ * Current step finished, so line up the next one after a short settle
+ */
+static void budgie_benchmark_advance(BudgieBenchmark *self)
+{
+        if (self->timeout_source > 0) {
+                g_source_remove(self->timeout_source);
+                self->timeout_source = 0;
+        }
+        self->target = NULL;
+
+        if (self->step == BENCHMARK_STEP_CLOSE) {
+                self->iteration++;
+                self->step = self->iteration < self->iterations ? BENCHMARK_STEP_OPEN
+                                                                : BENCHMARK_STEP_DONE;
+        } else {
+                self->step++;
+        }
+
+        g_timeout_add(BENCHMARK_SETTLE_MS, budgie_benchmark_next, self);
+}
+
+static void budgie_benchmark_complete(BudgieBenchmark *self, BudgieBenchmarkSample *sample)
+{
+        gint64 elapsed = g_get_monotonic_time() - self->start;
+
+        budgie_benchmark_sample_add(sample, elapsed);
+        if (sample == &self->rollover && elapsed > self->frame_budget) {
+                self->over_budget++;
+        }
+        budgie_benchmark_advance(self);
+}
+
+/**
+ * Work out how long a frame lasts on the monitor showing @window
+ */
+static gint64 budgie_benchmark_frame_budget(GtkWidget *window)
+{
+#if GTK_CHECK_VERSION(3, 22, 0)
+        GdkDisplay *display = gtk_widget_get_display(window);
+        GdkMonitor *monitor = NULL;
+        gint refresh = 0;
+
+        monitor = gdk_display_get_monitor_at_window(display, gtk_widget_get_window(window));
+        refresh = monitor ? gdk_monitor_get_refresh_rate(monitor) : 0;
+
+        /* Refresh rate is in millihertz */
+        if (refresh > 0) {
+                return (G_USEC_PER_SEC * 1000) / refresh;
+        }
+#else
+        (void)window;
+#endif
+        return BENCHMARK_FRAME_BUDGET_US;
+}
+
+/**
+ * Step never completed. Tidy up and carry on with the next iteration.
+ */
+static gboolean budgie_benchmark_step_timeout(gpointer v)
+{
+        BudgieBenchmark *self = v;
+
+        g_warning("Benchmark step %d of iteration %u timed out", self->step, self->iteration);
+        self->timeout_source = 0;
+        self->failures++;
+
+        for (guint i = 0; i < self->popovers->len; i++) {
+                gtk_widget_hide(self->popovers->pdata[i]);
+        }
+        self->step = BENCHMARK_STEP_CLOSE;
+        budgie_benchmark_advance(self);
+
+        return G_SOURCE_REMOVE;
+}
+
+/**
+ * Record how large the backing store for @popover is: one 32-bit pixel for
+ * every device pixel of the window, shadow and all
+ */
+static void budgie_benchmark_sample_backing(BudgieBenchmark *self, GtkWidget *popover)
+{
+        gint scale = gtk_widget_get_scale_factor(popover);
+        gint64 bytes = (gint64)gtk_widget_get_allocated_width(popover) *
+                       gtk_widget_get_allocated_height(popover) * scale * scale * 4;
+
+        budgie_benchmark_sample_add(&self->backing, bytes);
+}
+
+static gboolean budgie_benchmark_popover_draw(GtkWidget *popover,
+                                              __budgie_unused__ cairo_t *cr,
+                                              BudgieBenchmark *self)
+{
+        self->frames++;
+
+        if (popover != self->target) {
+                return GDK_EVENT_PROPAGATE;
+        }
+
+        if (self->step == BENCHMARK_STEP_OPEN) {
+                budgie_benchmark_sample_backing(self, popover);
+                budgie_benchmark_complete(self, &self->open);
+        } else if (self->step == BENCHMARK_STEP_ROLLOVER) {
+                budgie_benchmark_complete(self, &self->rollover);
+        }
+        return GDK_EVENT_PROPAGATE;
+}
+
+/**
+ * The revealer finished animating, so add up what the popover repainted
+ */
+static void budgie_benchmark_revealed(GtkWidget *revealer,
+                                      __budgie_unused__ GParamSpec *pspec,
+                                      BudgieBenchmark *self)
+{
+        const BudgieStats *stats = NULL;
+
+        if (self->step != BENCHMARK_STEP_REVEAL ||
+            !gtk_widget_is_ancestor(revealer, self->target)) {
+                return;
+        }
+
+        stats = budgie_popover_get_stats(BUDGIE_POPOVER(self->target));
+        self->reveal_redraws += stats->counters[BUDGIE_STATS_REDRAWS] - self->reveal_from_redraws;
+        self->reveal_pixels += stats->counters[BUDGIE_STATS_PIXELS] - self->reveal_from_pixels;
+        budgie_benchmark_complete(self, &self->reveal);
+}
+
+static void budgie_benchmark_popover_unmap(GtkWidget *popover, BudgieBenchmark *self)
+{
+        if (popover == self->target && self->step == BENCHMARK_STEP_CLOSE) {
+                budgie_benchmark_complete(self, &self->close);
+        }
+}
+
+/**
+ * Write the results as flat JSON, so that they're trivial to compare later
+ */
+static gchar *budgie_benchmark_to_json(BudgieBenchmark *self)
+{
+        BudgieStats stats;
+        const BudgieHistogram *grab = NULL;
+        const BudgieHistogram *ungrab = NULL;
+        const BudgieHistogram *rollover = NULL;
+
+        budgie_popover_manager_get_stats(self->manager, &stats);
+        grab = &stats.histograms[BUDGIE_STATS_GRAB];
+        ungrab = &stats.histograms[BUDGIE_STATS_UNGRAB];
+        rollover = &stats.histograms[BUDGIE_STATS_ROLLOVER];
+
+        return g_strdup_printf(
+            "{\n"
+            "  \"popovers\": %u,\n"
+            "  \"iterations\": %u,\n"
+            "  \"failures\": %u,\n"
+            "  \"open_mean_us\": %" G_GINT64_FORMAT ",\n"
+            "  \"open_max_us\": %" G_GINT64_FORMAT ",\n"
+            "  \"rollover_mean_us\": %" G_GINT64_FORMAT ",\n"
+            "  \"rollover_max_us\": %" G_GINT64_FORMAT ",\n"
+            "  \"close_mean_us\": %" G_GINT64_FORMAT ",\n"
+            "  \"close_max_us\": %" G_GINT64_FORMAT ",\n"
+            "  \"reveal_mean_us\": %" G_GINT64_FORMAT ",\n"
+            "  \"reveal_redraws\": %" G_GUINT64_FORMAT ",\n"
+            "  \"reveal_pixels_per_redraw\": %" G_GUINT64_FORMAT ",\n"
+            "  \"backing_bytes\": %" G_GINT64_FORMAT ",\n"
+            "  \"frames\": %" G_GUINT64_FORMAT ",\n"
+            "  \"geometry_queries\": %" G_GUINT64_FORMAT ",\n"
+            "  \"redraws\": %" G_GUINT64_FORMAT ",\n"
+            "  \"pixels_per_redraw\": %" G_GUINT64_FORMAT ",\n"
+            "  \"speculations\": %" G_GUINT64_FORMAT ",\n"
+            "  \"speculation_hits\": %" G_GUINT64_FORMAT ",\n"
+            "  \"grabs\": %" G_GUINT64_FORMAT ",\n"
+            "  \"grab_handoffs\": %" G_GUINT64_FORMAT ",\n"
+            "  \"grab_mean_us\": %" G_GINT64_FORMAT ",\n"
+            "  \"grab_max_us\": %" G_GINT64_FORMAT ",\n"
+            "  \"ungrabs\": %" G_GUINT64_FORMAT ",\n"
+            "  \"ungrab_mean_us\": %" G_GINT64_FORMAT ",\n"
+            "  \"frame_budget_us\": %" G_GINT64_FORMAT ",\n"
+            "  \"switch_mean_us\": %" G_GINT64_FORMAT ",\n"
+            "  \"switch_max_us\": %" G_GINT64_FORMAT ",\n"
+            "  \"switch_over_budget\": %u\n"
+            "}\n",
+            self->popovers->len,
+            self->iterations,
+            self->failures,
+            budgie_benchmark_sample_mean(&self->open),
+            self->open.max,
+            budgie_benchmark_sample_mean(&self->rollover),
+            self->rollover.max,
+            budgie_benchmark_sample_mean(&self->close),
+            self->close.max,
+            budgie_benchmark_sample_mean(&self->reveal),
+            self->reveal.count > 0 ? self->reveal_redraws / self->reveal.count : 0,
+            self->reveal_pixels / MAX(self->reveal_redraws, 1),
+            budgie_benchmark_sample_mean(&self->backing),
+            self->frames,
+            stats.counters[BUDGIE_STATS_GEOMETRY_QUERIES],
+            stats.counters[BUDGIE_STATS_REDRAWS],
+            stats.counters[BUDGIE_STATS_PIXELS] / MAX(stats.counters[BUDGIE_STATS_REDRAWS], 1),
+            stats.counters[BUDGIE_STATS_SPECULATIONS],
+            stats.counters[BUDGIE_STATS_SPECULATION_HITS],
+            grab->count,
+            grab->count - MIN(grab->count, ungrab->count),
+            budgie_benchmark_histogram_mean(grab),
+            grab->max,
+            ungrab->count,
+            budgie_benchmark_histogram_mean(ungrab),
+            self->frame_budget,
+            budgie_benchmark_histogram_mean(rollover),
+            rollover->max,
+            self->over_budget);
+}
+
+/**
+ * Find the integer value for @key in our own flat JSON output
+ */
+static gboolean budgie_benchmark_lookup(const gchar *json, const gchar *key, gint64 *value)
+{
+        gchar *needle = g_strdup_printf("\"%s\":", key);
+        const gchar *found = NULL;
+
+        found = strstr(json, needle);
+        if (found) {
+                *value = g_ascii_strtoll(found + strlen(needle), NULL, 10);
+        }
+        g_free(needle);
+        return found != NULL;
+}
+
+/**
+ * Compare our results against a previous run
+ *
+ * Returns: TRUE if nothing regressed
+ */
+static gboolean budgie_benchmark_compare(const gchar *json, const gchar *baseline)
+{
+        static const gchar *keys[] = {
+                "open_mean_us", "rollover_mean_us", "close_mean_us", "frames",
+                "geometry_queries", "backing_bytes", "grab_mean_us", "ungrabs",
+                "switch_mean_us", "pixels_per_redraw", "reveal_pixels_per_redraw",
+        };
+        gchar *contents = NULL;
+        GError *error = NULL;
+        gboolean ret = TRUE;
+
+        if (!g_file_get_contents(baseline, &contents, NULL, &error)) {
+                g_warning("Failed to read baseline %s: %s", baseline, error->message);
+                g_error_free(error);
+                return FALSE;
+        }
+
+        for (guint i = 0; i < G_N_ELEMENTS(keys); i++) {
+                gint64 old = 0;
+                gint64 new = 0;
+
+                if (!budgie_benchmark_lookup(contents, keys[i], &old) ||
+                    !budgie_benchmark_lookup(json, keys[i], &new)) {
+                        continue;
+                }
+                if ((gdouble)new > (gdouble)old * BENCHMARK_TOLERANCE) {
+                        g_printerr("Regression in %s: %" G_GINT64_FORMAT
+                                   " (baseline %" G_GINT64_FORMAT ")\n",
+                                   keys[i],
+                                   new,
+                                   old);
+                        ret = FALSE;
+                }
+        }
+        g_free(contents);
+        return ret;
+}
+
+/**
+ * Kick off the current step by injecting input through the display server
+ */
+static gboolean budgie_benchmark_next(gpointer v)
+{
+        BudgieBenchmark *self = v;
+        GdkWindow *window = NULL;
+        GtkWidget *button = NULL;
+        GdkDevice *pointer = NULL;
+        GtkWidget *revealer = NULL;
+        const BudgieStats *stats = NULL;
+        guint n_buttons = self->buttons->len;
+        guint index = 0;
+        gint x, y = 0;
+        gint origin_x, origin_y = 0;
+
+        if (self->step == BENCHMARK_STEP_DONE) {
+                gtk_main_quit();
+                return G_SOURCE_REMOVE;
+        }
+
+        /* Open one button and roll over to its neighbour */
+        index = self->iteration % (n_buttons - 1);
+        if (self->step != BENCHMARK_STEP_OPEN) {
+                index++;
+        }
+        button = self->buttons->pdata[index];
+        self->target = self->popovers->pdata[index];
+        window = gtk_widget_get_window(self->window);
+        budgie_benchmark_widget_centre(button, &x, &y);
+
+        self->timeout_source =
+            g_timeout_add(BENCHMARK_STEP_TIMEOUT_MS, budgie_benchmark_step_timeout, self);
+        self->start = g_get_monotonic_time();
+
+        switch (self->step) {
+        case BENCHMARK_STEP_OPEN:
+                gdk_test_simulate_button(window, x, y, 1, 0, GDK_BUTTON_PRESS);
+                gdk_test_simulate_button(window, x, y, 1, 0, GDK_BUTTON_RELEASE);
+                break;
+        case BENCHMARK_STEP_ROLLOVER:
+                /* A genuine pointer move, so that the manager sees the crossing */
+                gdk_window_get_origin(window, &origin_x, &origin_y);
+                pointer = gdk_seat_get_pointer(
+                    gdk_display_get_default_seat(gtk_widget_get_display(self->window)));
+                gdk_device_warp(pointer,
+                                gtk_widget_get_screen(self->window),
+                                origin_x + x,
+                                origin_y + y);
+                break;
+        case BENCHMARK_STEP_REVEAL:
+                /* Only what this popover repaints during the animation counts */
+                stats = budgie_popover_get_stats(BUDGIE_POPOVER(self->target));
+                self->reveal_from_redraws = stats->counters[BUDGIE_STATS_REDRAWS];
+                self->reveal_from_pixels = stats->counters[BUDGIE_STATS_PIXELS];
+                revealer = self->revealers->pdata[index];
+                gtk_revealer_set_reveal_child(GTK_REVEALER(revealer),
+                                              !gtk_revealer_get_reveal_child(
+                                                  GTK_REVEALER(revealer)));
+                break;
+        case BENCHMARK_STEP_CLOSE:
+                gdk_test_simulate_key(gtk_widget_get_window(self->target),
+                                      -1,
+                                      -1,
+                                      GDK_KEY_Escape,
+                                      0,
+                                      GDK_KEY_PRESS);
+                break;
+        default:
+                break;
+        }
+
+        return G_SOURCE_REMOVE;
+}
+
+static gboolean budgie_benchmark_button_press(GtkWidget *button,
+                                              __budgie_unused__ GdkEventButton *event,
+                                              BudgieBenchmark *self)
+{
+        budgie_popover_manager_show_popover(self->manager, button);
+        return GDK_EVENT_STOP;
+}
+
+/**
+ * Fake panel with @n_popovers buttons, each registered with the manager
+ */
+static void budgie_benchmark_build(BudgieBenchmark *self, guint n_popovers)
+{
+        GtkWidget *grid = NULL;
+
+        self->window = gtk_window_new(GTK_WINDOW_TOPLEVEL);
+        gtk_window_set_title(GTK_WINDOW(self->window), "Popover benchmark");
+        gtk_window_move(GTK_WINDOW(self->window), 0, 0);
+
+        grid = gtk_grid_new();
+        gtk_container_add(GTK_CONTAINER(self->window), grid);
+
+        for (guint i = 0; i < n_popovers; i++) {
+                gchar *label = g_strdup_printf("%u", i);
+                GtkWidget *button = NULL;
+                GtkWidget *popover = NULL;
+                GtkWidget *content = NULL;
+                GtkWidget *layout = NULL;
+                GtkWidget *revealer = NULL;
+                GtkWidget *extra = NULL;
+
+                button = gtk_button_new_with_label(label);
+                gtk_grid_attach(GTK_GRID(grid),
+                                button,
+                                (gint)(i % BENCHMARK_COLUMNS),
+                                (gint)(i / BENCHMARK_COLUMNS),
+                                1,
+                                1);
+
+                popover = budgie_popover_new(button);
+                layout = gtk_box_new(GTK_ORIENTATION_VERTICAL, 0);
+                content = gtk_label_new(label);
+                g_free(label);
+                gtk_widget_set_size_request(content, 200, 100);
+                gtk_box_pack_start(GTK_BOX(layout), content, FALSE, FALSE, 0);
+
+                /* Grows and shrinks the popover, as the demo's revealer does */
+                revealer = gtk_revealer_new();
+                extra = gtk_label_new("Revealed");
+                gtk_widget_set_size_request(extra, 200, 100);
+                gtk_container_add(GTK_CONTAINER(revealer), extra);
+                gtk_box_pack_start(GTK_BOX(layout), revealer, FALSE, FALSE, 0);
+                g_signal_connect(revealer,
+                                 "notify::child-revealed",
+                                 G_CALLBACK(budgie_benchmark_revealed),
+                                 self);
+
+                gtk_container_add(GTK_CONTAINER(popover), layout);
+                gtk_widget_show_all(layout);
+
+                g_signal_connect_after(popover,
+                                       "draw",
+                                       G_CALLBACK(budgie_benchmark_popover_draw),
+                                       self);
+                g_signal_connect_after(popover,
+                                       "unmap",
+                                       G_CALLBACK(budgie_benchmark_popover_unmap),
+                                       self);
+                g_signal_connect(button,
+                                 "button-press-event",
+                                 G_CALLBACK(budgie_benchmark_button_press),
+                                 self);
+
+                budgie_popover_manager_register_popover(self->manager,
+                                                        button,
+                                                        BUDGIE_POPOVER(popover));
+                g_ptr_array_add(self->buttons, button);
+                g_ptr_array_add(self->popovers, popover);
+                g_ptr_array_add(self->revealers, revealer);
+        }
+
+        gtk_widget_show_all(self->window);
+}
+
+/**
+ * budgie_popover_benchmark_run:
+ * @n_popovers: Number of popovers to register, at least 2
+ * @iterations: Number of open, roll-over, reveal and close cycles to measure
+ * @output: (allow-none): File to write the JSON results to, or NULL for stdout
+ * @baseline: (allow-none): Results of a previous run to compare against
+ *
+ * Drive the manager with synthetic input through the display server, i.e.
+ * under Xvfb, measuring how long each interaction takes to reach the screen.
+ *
+ * Returns: An exit status, failing on timeouts, on the seat being released
+ *          during a roll-over, on roll-overs averaging more than a frame, or
+ *          on regressions against @baseline
+ */
+int budgie_popover_benchmark_run(guint n_popovers, guint iterations, const gchar *output,
+                                 const gchar *baseline)
+{
+        BudgieBenchmark self = { 0 };
+        BudgieStats stats;
+        gint64 switch_mean = 0;
+        gchar *json = NULL;
+        GError *error = NULL;
+        int ret = EXIT_SUCCESS;
+
+        if (n_popovers < 2) {
+                g_warning("Benchmark needs at least 2 popovers for roll-over");
+                return EXIT_FAILURE;
+        }
+
+        self.manager = budgie_popover_manager_new();
+        self.buttons = g_ptr_array_new();
+        self.popovers = g_ptr_array_new();
+        self.revealers = g_ptr_array_new();
+        self.iterations = iterations;
+
+        budgie_benchmark_build(&self, n_popovers);
+        self.frame_budget = budgie_benchmark_frame_budget(self.window);
+        g_timeout_add(BENCHMARK_STARTUP_MS, budgie_benchmark_next, &self);
+
+        gtk_main();
+
+        json = budgie_benchmark_to_json(&self);
+        if (output) {
+                if (!g_file_set_contents(output, json, -1, &error)) {
+                        g_warning("Failed to write %s: %s", output, error->message);
+                        g_error_free(error);
+                        ret = EXIT_FAILURE;
+                }
+        } else {
+                g_print("%s", json);
+        }
+
+        if (self.failures > 0) {
+                ret = EXIT_FAILURE;
+        }
+
+        /* Each roll-over hands the grab over, so only closing may release it */
+        budgie_popover_manager_get_stats(self.manager, &stats);
+        if (stats.histograms[BUDGIE_STATS_UNGRAB].count > self.open.count) {
+                g_printerr("Seat was released %" G_GUINT64_FORMAT " times in %u menu sessions\n",
+                           stats.histograms[BUDGIE_STATS_UNGRAB].count,
+                           self.open.count);
+                ret = EXIT_FAILURE;
+        }
+
+        /* Rolling over should land within a frame, as GTK's own menus do */
+        switch_mean = budgie_benchmark_histogram_mean(&stats.histograms[BUDGIE_STATS_ROLLOVER]);
+        if (switch_mean > self.frame_budget) {
+                g_printerr("Roll-over takes %" G_GINT64_FORMAT "us on average, "
+                           "over the %" G_GINT64_FORMAT "us frame budget\n",
+                           switch_mean,
+                           self.frame_budget);
+                ret = EXIT_FAILURE;
+        }
+        if (baseline && !budgie_benchmark_compare(json, baseline)) {
+                ret = EXIT_FAILURE;
+        }
+
+        g_free(json);
+        gtk_widget_destroy(self.window);
+        for (guint i = 0; i < self.popovers->len; i++) {
+                gtk_widget_destroy(self.popovers->pdata[i]);
+        }
+        g_ptr_array_unref(self.popovers);
+        g_ptr_array_unref(self.revealers);
+        g_ptr_array_unref(self.buttons);
+        g_object_unref(self.manager);
+
+        return ret;
+}
+
+/**
+ * Current resident set size in kilobytes, or 0 if we can't tell
+ */
+static guint64 budgie_churn_rss(void)
+{
+        gchar *contents = NULL;
+        guint64 pages = 0;
+        gchar **fields = NULL;
+
+        if (!g_file_get_contents("/proc/self/statm", &contents, NULL, NULL)) {
+                return 0;
+        }
+        fields = g_strsplit(contents, " ", 3);
+        if (fields[0] && fields[1]) {
+                pages = g_ascii_strtoull(fields[1], NULL, 10);
+        }
+        g_strfreev(fields);
+        g_free(contents);
+
+        return pages * (guint64)sysconf(_SC_PAGESIZE) / 1024;
+}
+
+static void budgie_churn_flush(void)
+{
+        while (gtk_events_pending()) {
+                gtk_main_iteration_do(FALSE);
+        }
+}
+
+/**
+ * Nothing should still be connected to the manager once it forgot @object
+ */
+static guint budgie_churn_check_handlers(gpointer object, BudgiePopoverManager *manager)
+{
+        if (g_signal_handler_find(object, G_SIGNAL_MATCH_DATA, 0, 0, NULL, NULL, manager) == 0) {
+                return 0;
+        }
+        g_warning("Churn: %s %p still connected to the manager",
+                  G_OBJECT_TYPE_NAME(object),
+                  object);
+        return 1;
+}
+
+/**
+ * The geometry cache connects to @widget with its own data, so once neither
+ * the manager nor a popover points at @widget it must have let go as well
+ */
+static guint budgie_churn_check_tracked(GtkWidget *widget)
+{
+        if (!budgie_geometry_cache_is_tracked(widget)) {
+                return 0;
+        }
+        g_warning("Churn: %s %p is still tracked by the geometry cache",
+                  G_OBJECT_TYPE_NAME(widget),
+                  (gpointer)widget);
+        return 1;
+}
+
+/**
+ * Destroying a widget registered for shared content must never take the
+ * shared popover down with it, so every BudgiePopover still alive should be
+ * one of ours plus the shared one. Only possible with instance counting.
+ */
+static guint budgie_churn_check_shared(BudgieChurnSlot *slots)
+{
+        guint expected = 1;
+        guint instances = 0;
+
+        if (g_type_get_instance_count(BUDGIE_TYPE_POPOVER_MANAGER) == 0) {
+                return 0;
+        }
+        for (guint i = 0; i < CHURN_SLOTS; i++) {
+                if (slots[i].popover) {
+                        expected++;
+                }
+        }
+
+        instances = (guint)g_type_get_instance_count(BUDGIE_TYPE_POPOVER);
+        if (instances == expected) {
+                return 0;
+        }
+        g_warning("Churn: %u popovers alive, expected %u", instances, expected);
+        return 1;
+}
+
+static GtkWidget *budgie_churn_build_content(__budgie_unused__ GtkWidget *parent_widget,
+                                             __budgie_unused__ gpointer udata)
+{
+        return gtk_label_new("Churn");
+}
+
+/**
+ * Every factory registration must have its user data freed again
+ */
+static void budgie_churn_factory_freed(gpointer udata)
+{
+        gint *factories = udata;
+
+        (*factories)--;
+}
+
+static void budgie_churn_register(BudgiePopoverManager *manager, GtkWidget *box,
+                                  BudgieChurnSlot *slot, BudgieChurnKind kind, gint *factories)
+{
+        slot->button = gtk_button_new_with_label("Churn");
+        slot->kind = kind;
+        gtk_box_pack_start(GTK_BOX(box), slot->button, FALSE, FALSE, 0);
+        gtk_widget_show(slot->button);
+
+        switch (kind) {
+        case CHURN_KIND_CONTENT:
+                budgie_popover_manager_register_content(manager,
+                                                        slot->button,
+                                                        gtk_label_new("Churn"));
+                return;
+        case CHURN_KIND_FACTORY:
+                (*factories)++;
+                budgie_popover_manager_register_factory(manager,
+                                                        slot->button,
+                                                        budgie_churn_build_content,
+                                                        factories,
+                                                        budgie_churn_factory_freed);
+                return;
+        default:
+                break;
+        }
+
+        slot->popover = budgie_popover_new(slot->button);
+        gtk_container_add(GTK_CONTAINER(slot->popover), gtk_label_new("Churn"));
+        gtk_widget_show_all(gtk_bin_get_child(GTK_BIN(slot->popover)));
+
+        budgie_popover_manager_register_popover(manager,
+                                                slot->button,
+                                                BUDGIE_POPOVER(slot->popover));
+}
+
+/**
+ * Apply @operation to @slot, returning the number of leaks spotted
+ */
+static guint budgie_churn_apply(BudgiePopoverManager *manager, GtkWidget *box,
+                                BudgieChurnSlot *slot, BudgieChurnOperation operation,
+                                gint *factories)
+{
+        guint leaks = 0;
+
+        if (!slot->button) {
+                budgie_churn_register(manager,
+                                      box,
+                                      slot,
+                                      (BudgieChurnKind)(operation % CHURN_N_KINDS),
+                                      factories);
+                return 0;
+        }
+
+        switch (operation) {
+        case CHURN_SHOW:
+                budgie_popover_manager_show_popover(manager, slot->button);
+                return 0;
+        case CHURN_TIMEOUT:
+                /* Long runs then see factory content expire while we churn */
+                budgie_popover_manager_set_content_timeout(manager,
+                                                           slot->kind == CHURN_KIND_FACTORY ? 1
+                                                                                            : 0);
+                return 0;
+        case CHURN_DESTROY_WIDGET:
+                gtk_widget_destroy(slot->button);
+                break;
+        case CHURN_DESTROY_POPOVER:
+                if (!slot->popover) {
+                        gtk_widget_destroy(slot->button);
+                        break;
+                }
+                gtk_widget_destroy(slot->popover);
+                leaks += budgie_churn_check_handlers(slot->button, manager);
+                leaks += budgie_churn_check_tracked(slot->button);
+                gtk_widget_destroy(slot->button);
+                break;
+        case CHURN_UNREGISTER:
+                budgie_popover_manager_unregister_popover(manager, slot->button);
+                leaks += budgie_churn_check_handlers(slot->button, manager);
+                if (slot->popover) {
+                        leaks += budgie_churn_check_handlers(slot->popover, manager);
+                        gtk_widget_destroy(slot->popover);
+                }
+                leaks += budgie_churn_check_tracked(slot->button);
+                gtk_widget_destroy(slot->button);
+                break;
+        default:
+                return 0;
+        }
+
+        slot->button = NULL;
+        slot->popover = NULL;
+        return leaks;
+}
+
+/**
+ * budgie_popover_benchmark_churn:
+ * @operations: Number of random operations to perform
+ * @output: (allow-none): File to write the JSON results to, or NULL for stdout
+ *
+ * Register, show, destroy and unregister popovers, shared content and
+ * content factories in a reproducible random order, much like a panel
+ * reloading its applets. The run fails if anything is left connected to the
+ * manager or tracked by the geometry cache, if the toplevel is still being
+ * watched once the manager is gone, if popover instances outlive the run
+ * (main() turns on GOBJECT_DEBUG=instance-count for us), or if resident
+ * memory keeps growing once warmed up.
+ *
+ * Returns: An exit status
+ */
+int budgie_popover_benchmark_churn(guint operations, const gchar *output)
+{
+        BudgieChurnSlot slots[CHURN_SLOTS] = { { 0 } };
+        BudgiePopoverManager *manager = NULL;
+        GtkWidget *window = NULL;
+        GtkWidget *box = NULL;
+        GRand *rand = NULL;
+        GError *error = NULL;
+        gchar *json = NULL;
+        guint64 rss_start = 0;
+        guint64 rss_end = 0;
+        guint leaks = 0;
+        guint shared_lost = 0;
+        guint instances = 0;
+        guint resident = 0;
+        gint factories = 0;
+        int ret = EXIT_SUCCESS;
+
+        manager = budgie_popover_manager_new();
+        rand = g_rand_new_with_seed(0);
+
+        window = gtk_window_new(GTK_WINDOW_TOPLEVEL);
+        gtk_window_set_title(GTK_WINDOW(window), "Popover churn");
+        box = gtk_box_new(GTK_ORIENTATION_HORIZONTAL, 0);
+        gtk_container_add(GTK_CONTAINER(window), box);
+        gtk_widget_show_all(window);
+
+        for (guint i = 0; i < operations; i++) {
+                BudgieChurnSlot *slot = &slots[g_rand_int_range(rand, 0, CHURN_SLOTS)];
+                gint op = g_rand_int_range(rand, 0, CHURN_N_OPERATIONS);
+                gboolean shared = slot->button && !slot->popover;
+
+                leaks += budgie_churn_apply(manager,
+                                            box,
+                                            slot,
+                                            (BudgieChurnOperation)op,
+                                            &factories);
+                budgie_churn_flush();
+                if (shared && !slot->button) {
+                        shared_lost += budgie_churn_check_shared(slots);
+                }
+
+                /* Measure growth only once everything has been allocated once */
+                if (i == operations / 10) {
+                        rss_start = budgie_churn_rss();
+                }
+        }
+
+        /* Content that is still registered stays resident until unregistered */
+        resident = budgie_popover_manager_get_resident_content(manager);
+
+        for (guint i = 0; i < CHURN_SLOTS; i++) {
+                if (slots[i].button) {
+                        leaks += budgie_churn_apply(manager,
+                                                    box,
+                                                    &slots[i],
+                                                    CHURN_UNREGISTER,
+                                                    &factories);
+                }
+        }
+        budgie_churn_flush();
+
+        /* The shared popover lives as long as the manager does */
+        rss_end = budgie_churn_rss();
+
+        /* Disposing lets go of the toplevel, which outlives the manager here */
+        g_object_run_dispose(G_OBJECT(manager));
+        leaks += budgie_churn_check_handlers(window, manager);
+        g_object_unref(manager);
+        instances = (guint)g_type_get_instance_count(BUDGIE_TYPE_POPOVER);
+        if (factories != 0) {
+                g_warning("Churn: %d factories were never freed", factories);
+                leaks++;
+        }
+
+        json = g_strdup_printf(
+            "{\n"
+            "  \"operations\": %u,\n"
+            "  \"rss_start_kb\": %" G_GUINT64_FORMAT ",\n"
+            "  \"rss_end_kb\": %" G_GUINT64_FORMAT ",\n"
+            "  \"popover_instances\": %u,\n"
+            "  \"handler_leaks\": %u,\n"
+            "  \"shared_lost\": %u,\n"
+            "  \"resident_content\": %u\n"
+            "}\n",
+            operations,
+            rss_start,
+            rss_end,
+            instances,
+            leaks,
+            shared_lost,
+            resident);
+        if (output) {
+                if (!g_file_set_contents(output, json, -1, &error)) {
+                        g_warning("Failed to write %s: %s", output, error->message);
+                        g_error_free(error);
+                        ret = EXIT_FAILURE;
+                }
+        } else {
+                g_print("%s", json);
+        }
+        g_free(json);
+
+        if (leaks > 0 || instances > 0 || shared_lost > 0) {
+                ret = EXIT_FAILURE;
+        }
+        if (rss_start > 0 && rss_end > rss_start + CHURN_RSS_SLACK) {
+                g_printerr("Resident memory grew by %" G_GUINT64_FORMAT "kB\n",
+                           rss_end - rss_start);
+                ret = EXIT_FAILURE;
+        }
+
+        gtk_widget_destroy(window);
+        g_rand_free(rand);
+
+        return ret;
+}
+
+/**
+ * budgie_popover_benchmark_blur:
+ * @iterations: Number of blurs to time for each radius
+ * @output: (allow-none): File to write the JSON results to, or NULL for stdout
+ *
+ * Time the shadow blur kernel on its own, without a display. The cost per
+ * pixel should stay flat as the radius grows.
+ *
+ * The only figures recorded so far, about 18-20 ns per pixel for every
+ * radius, came from building popover-shadow.c alone with gcc -O2 and the
+ * same loop, not from this mode. Compare later runs of this mode with each
+ * other rather than with those.
+ *
+ * Returns: An exit status
+ */
+int budgie_popover_benchmark_blur(guint iterations, const gchar *output)
+{
+        GString *json = NULL;
+        GError *error = NULL;
+        guint8 *pixels = NULL;
+        gint stride = BLUR_WIDTH;
+        int ret = EXIT_SUCCESS;
+
+        pixels = g_malloc((gsize)stride * BLUR_HEIGHT);
+        json = g_string_new("{\n");
+        g_string_append_printf(json, "  \"iterations\": %u", iterations);
+
+        for (guint i = 0; i < G_N_ELEMENTS(blur_radii); i++) {
+                gint64 start = 0;
+                gint64 elapsed = 0;
+
+                start = g_get_monotonic_time();
+                for (guint j = 0; j < iterations; j++) {
+                        /* Opaque body in the middle, clear margins around it */
+                        memset(pixels, 0, (gsize)stride * BLUR_HEIGHT);
+                        for (gint y = BLUR_HEIGHT / 4; y < (BLUR_HEIGHT * 3) / 4; y++) {
+                                memset(pixels + y * stride + BLUR_WIDTH / 4, 0xFF, BLUR_WIDTH / 2);
+                        }
+                        budgie_shadow_blur(pixels, BLUR_WIDTH, BLUR_HEIGHT, stride, blur_radii[i]);
+                }
+                elapsed = g_get_monotonic_time() - start;
+
+                g_string_append_printf(json,
+                                       ",\n  \"blur_r%d_ns_per_pixel\": %.2f",
+                                       blur_radii[i],
+                                       ((gdouble)elapsed * 1000.0) /
+                                           ((gdouble)iterations * BLUR_WIDTH * BLUR_HEIGHT));
+        }
+        g_string_append(json, "\n}\n");
+        g_free(pixels);
+
+        if (output) {
+                if (!g_file_set_contents(output, json->str, -1, &error)) {
+                        g_warning("Failed to write %s: %s", output, error->message);
+                        g_error_free(error);
+                        ret = EXIT_FAILURE;
+                }
+        } else {
+                g_print("%s", json->str);
+        }
+        g_string_free(json, TRUE);
+
+        return ret;
+}
+
+/**
+ * Count the handlers connected to @object with @data, without disturbing them
+ */
+static guint budgie_dispatch_count_handlers(gpointer object, gpointer data)
+{
+        guint n = 0;
+
+        n = g_signal_handlers_block_matched(object, G_SIGNAL_MATCH_DATA, 0, 0, NULL, NULL, data);
+        g_signal_handlers_unblock_matched(object, G_SIGNAL_MATCH_DATA, 0, 0, NULL, NULL, data);
+        return n;
+}
+
+/**
+ * Fake panel of @n bare buttons in a grid, each registered with @manager
+ * along with a popover. The buttons and popovers are appended to @buttons
+ * and @popovers respectively.
+ *
+ * Returns: (transfer full): The panel window, already shown
+ */
+static GtkWidget *budgie_panel_new(BudgiePopoverManager *manager, guint n, GPtrArray *buttons,
+                                   GPtrArray *popovers)
+{
+        GtkWidget *window = NULL;
+        GtkWidget *grid = NULL;
+
+        window = gtk_window_new(GTK_WINDOW_TOPLEVEL);
+        gtk_window_move(GTK_WINDOW(window), 0, 0);
+        grid = gtk_grid_new();
+        gtk_container_add(GTK_CONTAINER(window), grid);
+
+        for (guint i = 0; i < n; i++) {
+                GtkWidget *button = gtk_button_new();
+                GtkWidget *popover = NULL;
+
+                gtk_grid_attach(GTK_GRID(grid),
+                                button,
+                                (gint)(i % BENCHMARK_COLUMNS),
+                                (gint)(i / BENCHMARK_COLUMNS),
+                                1,
+                                1);
+                popover = budgie_popover_new(button);
+                gtk_container_add(GTK_CONTAINER(popover), gtk_label_new("Panel"));
+                gtk_widget_show_all(gtk_bin_get_child(GTK_BIN(popover)));
+                budgie_popover_manager_register_popover(manager, button, BUDGIE_POPOVER(popover));
+                g_ptr_array_add(buttons, button);
+                g_ptr_array_add(popovers, popover);
+        }
+
+        gtk_widget_show_all(window);
+        return window;
+}
+
+/**
+ * Give the display server up to two seconds to map @widget
+ *
+ * Returns: TRUE if @widget is now mapped
+ */
+static gboolean budgie_panel_wait_mapped(GtkWidget *widget)
+{
+        for (guint i = 0; i < 200 && !gtk_widget_get_mapped(widget); i++) {
+                budgie_churn_flush();
+                g_usleep(10000);
+        }
+        return gtk_widget_get_mapped(widget);
+}
+
+/**
+ * Destroy a panel from budgie_panel_new() along with its popovers
+ */
+static void budgie_panel_free(GtkWidget *window, GPtrArray *buttons, GPtrArray *popovers)
+{
+        gtk_widget_destroy(window);
+        for (guint i = 0; i < popovers->len; i++) {
+                gtk_widget_destroy(popovers->pdata[i]);
+        }
+        g_ptr_array_unref(popovers);
+        g_ptr_array_unref(buttons);
+}
+
+/**
+ * Register @n popovers, then time crossing events delivered to the open one.
+ * The events land outside of every registered widget, so each one pays for
+ * the full dispatch and lookup without triggering a roll-over.
+ *
+ * Returns: TRUE if the popover could be opened and measured, and no popover
+ * had hooked itself up to the screen or panel toplevel
+ */
+static gboolean budgie_dispatch_measure(guint n, GString *json)
+{
+        BudgiePopoverManager *manager = NULL;
+        GtkWidget *window = NULL;
+        GPtrArray *buttons = NULL;
+        GPtrArray *popovers = NULL;
+        GdkEvent *event = NULL;
+        guint64 rss_start = 0;
+        guint64 rss_end = 0;
+        guint handlers = 0;
+        guint widget_handlers = 0;
+        guint shared_handlers = 0;
+        gint64 elapsed = 0;
+
+        manager = budgie_popover_manager_new();
+        buttons = g_ptr_array_new();
+        popovers = g_ptr_array_new();
+
+        budgie_churn_flush();
+        rss_start = budgie_churn_rss();
+
+        window = budgie_panel_new(manager, n, buttons, popovers);
+        budgie_churn_flush();
+        rss_end = budgie_churn_rss();
+
+        /* The manager follows the screen and panel for its popovers, so none of
+         * them should be hooked up to either themselves */
+        for (guint i = 0; i < popovers->len; i++) {
+                handlers += budgie_dispatch_count_handlers(popovers->pdata[i], manager);
+                widget_handlers += budgie_dispatch_count_handlers(buttons->pdata[i], manager);
+                shared_handlers +=
+                    budgie_dispatch_count_handlers(gdk_screen_get_default(), popovers->pdata[i]);
+                shared_handlers += budgie_dispatch_count_handlers(window, popovers->pdata[i]);
+        }
+        if (shared_handlers > 0) {
+                g_warning("Dispatch: %u popover handlers on the screen or panel, %u registered",
+                          shared_handlers,
+                          n);
+        }
+
+        /* Open the first popover, giving the display server a moment */
+        budgie_popover_manager_show_popover(manager, buttons->pdata[0]);
+        if (budgie_panel_wait_mapped(popovers->pdata[0])) {
+                GtkWidget *popover = popovers->pdata[0];
+
+                event = gdk_event_new(GDK_ENTER_NOTIFY);
+                event->crossing.window = g_object_ref(gtk_widget_get_window(popover));
+                event->crossing.x_root = -10000;
+                event->crossing.y_root = -10000;
+
+                /* First lookup builds the roll-over index, so leave it out */
+                gtk_widget_event(popover, event);
+
+                elapsed = g_get_monotonic_time();
+                for (guint i = 0; i < DISPATCH_EVENTS; i++) {
+                        gtk_widget_event(popover, event);
+                }
+                elapsed = g_get_monotonic_time() - elapsed;
+                gdk_event_free(event);
+
+                gtk_widget_hide(popover);
+        } else {
+                g_warning("Dispatch: popover never mapped with %u registered", n);
+        }
+
+        g_string_append_printf(json,
+                               ",\n  \"dispatch_%u_rss_per_popover\": %" G_GUINT64_FORMAT,
+                               n,
+                               rss_end > rss_start ? ((rss_end - rss_start) * 1024) / n : 0);
+        g_string_append_printf(json,
+                               ",\n  \"dispatch_%u_handlers_per_popover\": %.2f",
+                               n,
+                               (gdouble)handlers / n);
+        g_string_append_printf(json,
+                               ",\n  \"dispatch_%u_widget_handlers_per_popover\": %.2f",
+                               n,
+                               (gdouble)widget_handlers / n);
+        g_string_append_printf(json,
+                               ",\n  \"dispatch_%u_screen_panel_handlers\": %u",
+                               n,
+                               shared_handlers);
+        g_string_append_printf(json,
+                               ",\n  \"dispatch_%u_crossing_ns\": %.1f",
+                               n,
+                               ((gdouble)elapsed * 1000.0) / DISPATCH_EVENTS);
+
+        budgie_panel_free(window, buttons, popovers);
+        g_object_unref(manager);
+        budgie_churn_flush();
+
+        return elapsed > 0 && shared_handlers == 0;
+}
+
+/**
+ * budgie_popover_benchmark_dispatch:
+ * @output: (allow-none): File to write the JSON results to, or NULL for stdout
+ *
+ * Measure the resident memory and manager signal handlers that each
+ * registered popover costs, and the time taken to dispatch a single crossing
+ * event to the open popover, with 10, 100 and 1000 registrations. The
+ * manager's handlers on each registered widget, i.e. "destroy", are reported
+ * separately, as they fire for that widget alone. Popovers holding handlers
+ * on the screen or panel toplevel fail the run, as the manager hooks those
+ * up once on behalf of all of them.
+ *
+ * Returns: An exit status
+ */
+int budgie_popover_benchmark_dispatch(const gchar *output)
+{
+        GString *json = NULL;
+        GError *error = NULL;
+        int ret = EXIT_SUCCESS;
+
+        json = g_string_new("{\n");
+        g_string_append_printf(json, "  \"events\": %u", DISPATCH_EVENTS);
+
+        for (guint i = 0; i < G_N_ELEMENTS(dispatch_sizes); i++) {
+                if (!budgie_dispatch_measure(dispatch_sizes[i], json)) {
+                        ret = EXIT_FAILURE;
+                }
+        }
+        g_string_append(json, "\n}\n");
+
+        if (output) {
+                if (!g_file_set_contents(output, json->str, -1, &error)) {
+                        g_warning("Failed to write %s: %s", output, error->message);
+                        g_error_free(error);
+                        ret = EXIT_FAILURE;
+                }
+        } else {
+                g_print("%s", json->str);
+        }
+        g_string_free(json, TRUE);
+
+        return ret;
+}
+
+/**
+ * Register @n popovers, then time looking up random points across the panel
+ * through the roll-over index
+ *
+ * Returns: TRUE if the lookups found the registered widgets
+ */
+static gboolean budgie_lookup_measure(guint n, GString *json)
+{
+        BudgiePopoverManager *manager = NULL;
+        GtkWidget *window = NULL;
+        GPtrArray *buttons = NULL;
+        GPtrArray *popovers = NULL;
+        GRand *rand = NULL;
+        gint *points = NULL;
+        gint origin_x, origin_y = 0;
+        gint width, height = 0;
+        guint hits = 0;
+        gint64 elapsed = 0;
+
+        manager = budgie_popover_manager_new();
+        buttons = g_ptr_array_new();
+        popovers = g_ptr_array_new();
+        window = budgie_panel_new(manager, n, buttons, popovers);
+
+        if (!budgie_panel_wait_mapped(window)) {
+                g_warning("Lookup: panel never mapped with %u registered", n);
+                budgie_panel_free(window, buttons, popovers);
+                g_object_unref(manager);
+                return FALSE;
+        }
+        budgie_churn_flush();
+
+        /* Pick the points up front so that only the lookups are timed */
+        gdk_window_get_origin(gtk_widget_get_window(window), &origin_x, &origin_y);
+        gtk_window_get_size(GTK_WINDOW(window), &width, &height);
+        rand = g_rand_new_with_seed(n);
+        points = g_new(gint, LOOKUP_QUERIES * 2);
+        for (guint i = 0; i < LOOKUP_QUERIES; i++) {
+                points[i * 2] = origin_x + g_rand_int_range(rand, 0, MAX(width, 1));
+                points[i * 2 + 1] = origin_y + g_rand_int_range(rand, 0, MAX(height, 1));
+        }
+
+        /* First lookup builds the roll-over index, so leave it out */
+        budgie_popover_manager_get_widget_at(manager, points[0], points[1]);
+
+        elapsed = g_get_monotonic_time();
+        for (guint i = 0; i < LOOKUP_QUERIES; i++) {
+                gint *point = points + i * 2;
+
+                if (budgie_popover_manager_get_widget_at(manager, point[0], point[1])) {
+                        hits++;
+                }
+        }
+        elapsed = g_get_monotonic_time() - elapsed;
+
+        g_string_append_printf(json,
+                               ",\n  \"lookup_%u_ns\": %.1f",
+                               n,
+                               ((gdouble)elapsed * 1000.0) / LOOKUP_QUERIES);
+        g_string_append_printf(json, ",\n  \"lookup_%u_hits\": %u", n, hits);
+
+        g_free(points);
+        g_rand_free(rand);
+        budgie_panel_free(window, buttons, popovers);
+        g_object_unref(manager);
+        budgie_churn_flush();
+
+        return hits > 0;
+}
+
+/**
+ * budgie_popover_benchmark_lookup:
+ * @output: (allow-none): File to write the JSON results to, or NULL for stdout
+ *
+ * Time hit-testing a screen position against the registered widgets with
+ * 2, 10, 100 and 1000 registrations. The cost per lookup should stay flat as
+ * the panel grows.
+ *
+ * Returns: An exit status
+ */
+int budgie_popover_benchmark_lookup(const gchar *output)
+{
+        GString *json = NULL;
+        GError *error = NULL;
+        int ret = EXIT_SUCCESS;
+
+        json = g_string_new("{\n");
+        g_string_append_printf(json, "  \"queries\": %u", LOOKUP_QUERIES);
+
+        for (guint i = 0; i < G_N_ELEMENTS(lookup_sizes); i++) {
+                if (!budgie_lookup_measure(lookup_sizes[i], json)) {
+                        ret = EXIT_FAILURE;
+                }
+        }
+        g_string_append(json, "\n}\n");
+
+        if (output) {
+                if (!g_file_set_contents(output, json->str, -1, &error)) {
+                        g_warning("Failed to write %s: %s", output, error->message);
+                        g_error_free(error);
+                        ret = EXIT_FAILURE;
+                }
+        } else {
+                g_print("%s", json->str);
+        }
+        g_string_free(json, TRUE);
+
+        return ret;
+}
+
+/**
+ * Lay out @n synthetic monitors side by side, with a panel along the top of
+ * all of them, then time finding the monitor for a random panel button and
+ * placing a popover on it
+ *
+ * Returns: TRUE if every popover landed on the monitor of its button
+ */
+static gboolean budgie_monitors_measure(guint n, GString *json)
+{
+        BudgieMonitorInfo monitors[MONITORS_MAX];
+        GdkRectangle *anchors = NULL;
+        GRand *rand = NULL;
+        guint misplaced = 0;
+        gint64 elapsed = 0;
+
+        for (guint i = 0; i < n; i++) {
+                GdkRectangle geometry = {
+                        .x = (gint)i * MONITORS_WIDTH,
+                        .y = 0,
+                        .width = MONITORS_WIDTH,
+                        .height = MONITORS_HEIGHT,
+                };
+                monitors[i].geometry = geometry;
+                monitors[i].workarea = geometry;
+        }
+
+        /* Pick the buttons up front so that only the placements are timed */
+        rand = g_rand_new_with_seed(n);
+        anchors = g_new(GdkRectangle, MONITORS_PLACEMENTS);
+        for (guint i = 0; i < MONITORS_PLACEMENTS; i++) {
+                anchors[i].width = g_rand_int_range(rand, 16, 64);
+                anchors[i].height = 32;
+                anchors[i].x =
+                    g_rand_int_range(rand, 0, (gint)n * MONITORS_WIDTH - anchors[i].width);
+                anchors[i].y = 0;
+        }
+
+        elapsed = g_get_monotonic_time();
+        for (guint i = 0; i < MONITORS_PLACEMENTS; i++) {
+                const BudgieMonitorInfo *monitor = NULL;
+                BudgiePlacementInput input = { 0 };
+                BudgiePlacement placement;
+
+                monitor = budgie_monitor_find(monitors, n, &anchors[i]);
+                input.anchor.x = anchors[i].x;
+                input.anchor.y = anchors[i].y;
+                input.anchor.width = anchors[i].width;
+                input.anchor.height = anchors[i].height;
+                input.monitor.x = monitor->geometry.x;
+                input.monitor.y = monitor->geometry.y;
+                input.monitor.width = monitor->geometry.width;
+                input.monitor.height = monitor->geometry.height;
+                input.width = 400;
+                input.height = 300;
+                input.edge = BUDGIE_PLACEMENT_EDGE_TOP;
+                input.tail_dimension = 20;
+                input.shadow_dimension = 4;
+                budgie_placement_compute(&input, &placement);
+
+                if (placement.x < input.monitor.x ||
+                    placement.x + input.width > input.monitor.x + input.monitor.width) {
+                        misplaced++;
+                }
+        }
+        elapsed = g_get_monotonic_time() - elapsed;
+
+        g_string_append_printf(json,
+                               ",\n  \"monitors_%u_ns\": %.1f",
+                               n,
+                               ((gdouble)elapsed * 1000.0) / MONITORS_PLACEMENTS);
+        g_string_append_printf(json, ",\n  \"monitors_%u_misplaced\": %u", n, misplaced);
+
+        g_free(anchors);
+        g_rand_free(rand);
+
+        return misplaced == 0;
+}
+
+/**
+ * budgie_popover_benchmark_monitors:
+ * @output: (allow-none): File to write the JSON results to, or NULL for stdout
+ *
+ * Time choosing a monitor and placing a popover on it with 1 to 8 synthetic
+ * monitors. This needs no real display, and the cost per placement should
+ * barely move with the monitor count.
+ *
+ * Returns: An exit status
+ */
+int budgie_popover_benchmark_monitors(const gchar *output)
+{
+        GString *json = NULL;
+        GError *error = NULL;
+        int ret = EXIT_SUCCESS;
+
+        json = g_string_new("{\n");
+        g_string_append_printf(json, "  \"placements\": %u", MONITORS_PLACEMENTS);
+
+        for (guint n = 1; n <= MONITORS_MAX; n++) {
+                if (!budgie_monitors_measure(n, json)) {
+                        ret = EXIT_FAILURE;
+                }
+        }
+        g_string_append(json, "\n}\n");
+
+        if (output) {
+                if (!g_file_set_contents(output, json->str, -1, &error)) {
+                        g_warning("Failed to write %s: %s", output, error->message);
+                        g_error_free(error);
+                        ret = EXIT_FAILURE;
+                }
+        } else {
+                g_print("%s", json->str);
+        }
+        g_string_free(json, TRUE);
+
+        return ret;
+}
+
+/*
+ * Editor modelines  -  https://www.wireshark.org/tools/modelines.html
+ *
+ * Local variables:
+ * c-basic-offset: 8
+ * tab-width: 8
+ * indent-tabs-mode: nil
+ * End:
+ *
+ * vi: set shiftwidth=8 tabstop=8 expandtab:
+ * :indentSize=8:tabSize=8:noTabs=true:
+ */
@@ -0,0 +1,39 @@
+/*
+ * This file is part of ui-tests
+ *
+ * Copyright © 2016-2017 Ikey Doherty <ikey@solus-project.com>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ */
+
+#pragma once
+
+#include <glib.h>
+
+G_BEGIN_DECLS
+
+int budgie_popover_benchmark_run(guint n_popovers, guint iterations, const gchar *output,
+                                 const gchar *baseline);
+int budgie_popover_benchmark_churn(guint operations, const gchar *output);
+int budgie_popover_benchmark_blur(guint iterations, const gchar *output);
+int budgie_popover_benchmark_dispatch(const gchar *output);
+int budgie_popover_benchmark_lookup(const gchar *output);
+int budgie_popover_benchmark_monitors(const gchar *output);
+
+G_END_DECLS
+
+/*
+ * Editor modelines  -  https://www.wireshark.org/tools/modelines.html
+ *
+ * Local variables:
+ * c-basic-offset: 8
+ * tab-width: 8
+ * indent-tabs-mode: nil
+ * End:
+ *
+ * vi: set shiftwidth=8 tabstop=8 expandtab:
+ * :indentSize=8:tabSize=8:noTabs=true:
+ */
@@ -0,0 +1,384 @@
+/*
+ * This file is part of ui-tests
+ *
+ * Copyright © 2016-2017 Ikey Doherty <ikey@solus-project.com>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ */
+
+#define _GNU_SOURCE
+
+#include "util.h"
+
+BUDGIE_BEGIN_PEDANTIC
+#include "geometry-cache.h"
+#include <gtk/gtk.h>
+BUDGIE_END_PEDANTIC
+
+/**
+ * Per-widget tracking: geometry relative to the toplevel window
+ */
+typedef struct BudgieWidgetGeometry {
+        guint refs;
+        GdkRectangle rect;
+        gboolean valid;
+        guint layout_serial; /* Value of layout_serial that @rect was computed at */
+        gulong allocate_id;
+        gulong hierarchy_id;
+} BudgieWidgetGeometry;
+
+/**
+ * Per-toplevel tracking: absolute origin of the toplevel window. This lives
+ * for as long as the toplevel does, as there are very few of them.
+ */
+typedef struct BudgieToplevelGeometry {
+        gint x;
+        gint y;
+        gboolean valid;
+} BudgieToplevelGeometry;
+
+/**
+ * Bumped every time any tracked geometry changes, allowing consumers to
+ * cheaply determine whether their own derived state is out of date.
+ */
+static guint geometry_serial = 1;
+
+/**
+ * Bumped whenever a windowed ancestor of a tracked widget is allocated.
+ * Allocations are relative to the nearest parent GdkWindow, so moving such an
+ * ancestor leaves the allocation of the widget itself untouched.
+ */
+static guint layout_serial = 1;
+
+static GQuark budgie_geometry_widget_quark(void)
+{
+        static GQuark quark = 0;
+
+        if (G_UNLIKELY(quark == 0)) {
+                quark = g_quark_from_static_string("budgie-geometry-widget");
+        }
+        return quark;
+}
+
+static GQuark budgie_geometry_ancestor_quark(void)
+{
+        static GQuark quark = 0;
+
+        if (G_UNLIKELY(quark == 0)) {
+                quark = g_quark_from_static_string("budgie-geometry-ancestor");
+        }
+        return quark;
+}
+
+static GQuark budgie_geometry_toplevel_quark(void)
+{
+        static GQuark quark = 0;
+
+        if (G_UNLIKELY(quark == 0)) {
+                quark = g_quark_from_static_string("budgie-geometry-toplevel");
+        }
+        return quark;
+}
+
+/**
+ * The toplevel moved or resized, so update our idea of where it lives
+ */
+static gboolean budgie_geometry_toplevel_configured(__budgie_unused__ GtkWidget *toplevel,
+                                                    GdkEventConfigure *event,
+                                                    BudgieToplevelGeometry *geom)
+{
+        if (!geom->valid || geom->x != event->x || geom->y != event->y) {
+                geom->x = event->x;
+                geom->y = event->y;
+                geom->valid = TRUE;
+                geometry_serial++;
+        }
+        return GDK_EVENT_PROPAGATE;
+}
+
+/**
+ * Find (or start tracking) the given toplevel
+ */
+static BudgieToplevelGeometry *budgie_geometry_get_toplevel(GtkWidget *toplevel)
+{
+        BudgieToplevelGeometry *geom = NULL;
+
+        geom = g_object_get_qdata(G_OBJECT(toplevel), budgie_geometry_toplevel_quark());
+        if (geom) {
+                return geom;
+        }
+
+        geom = g_new0(BudgieToplevelGeometry, 1);
+        g_object_set_qdata_full(G_OBJECT(toplevel), budgie_geometry_toplevel_quark(), geom, g_free);
+        g_signal_connect(toplevel,
+                         "configure-event",
+                         G_CALLBACK(budgie_geometry_toplevel_configured),
+                         geom);
+        return geom;
+}
+
+/**
+ * A windowed ancestor was laid out again, and may have taken tracked widgets
+ * along with it without them being allocated themselves
+ */
+static void budgie_geometry_ancestor_allocated(__budgie_unused__ GtkWidget *ancestor,
+                                               __budgie_unused__ GtkAllocation *allocation,
+                                               __budgie_unused__ gpointer udata)
+{
+        layout_serial++;
+        geometry_serial++;
+}
+
+/**
+ * Ensure we hear about every windowed ancestor of @widget, up to and including
+ * the toplevel, being allocated. Each ancestor is only hooked up once and
+ * stays hooked up for as long as it lives, as there are very few of them.
+ */
+static void budgie_geometry_watch_ancestors(GtkWidget *widget)
+{
+        for (GtkWidget *ancestor = gtk_widget_get_parent(widget); ancestor;
+             ancestor = gtk_widget_get_parent(ancestor)) {
+                if (!gtk_widget_get_has_window(ancestor)) {
+                        continue;
+                }
+                if (g_object_get_qdata(G_OBJECT(ancestor), budgie_geometry_ancestor_quark())) {
+                        continue;
+                }
+                g_object_set_qdata(G_OBJECT(ancestor),
+                                   budgie_geometry_ancestor_quark(),
+                                   GINT_TO_POINTER(1));
+                g_signal_connect_after(ancestor,
+                                       "size-allocate",
+                                       G_CALLBACK(budgie_geometry_ancestor_allocated),
+                                       NULL);
+        }
+}
+
+/**
+ * Recompute the widget geometry relative to its toplevel. This is entirely
+ * client side and doesn't need to talk to the display server.
+ */
+static void budgie_geometry_update_widget(GtkWidget *widget, BudgieWidgetGeometry *geom)
+{
+        GtkAllocation alloc = { 0 };
+        GtkWidget *toplevel = NULL;
+        gint x, y = 0;
+
+        toplevel = gtk_widget_get_toplevel(widget);
+        if (!gtk_widget_is_toplevel(toplevel) ||
+            !gtk_widget_translate_coordinates(widget, toplevel, 0, 0, &x, &y)) {
+                geom->valid = FALSE;
+                return;
+        }
+
+        /* Ensure we hear about the toplevel, or anything between us, moving */
+        budgie_geometry_get_toplevel(toplevel);
+        budgie_geometry_watch_ancestors(widget);
+
+        gtk_widget_get_allocation(widget, &alloc);
+        geom->rect = (GdkRectangle){.x = x, .y = y, .width = alloc.width, .height = alloc.height };
+        geom->valid = TRUE;
+        geom->layout_serial = layout_serial;
+}
+
+static void budgie_geometry_widget_allocated(GtkWidget *widget,
+                                             __budgie_unused__ GtkAllocation *allocation,
+                                             BudgieWidgetGeometry *geom)
+{
+        GdkRectangle old = geom->rect;
+        gboolean was_valid = geom->valid;
+
+        budgie_geometry_update_widget(widget, geom);
+
+        if (was_valid != geom->valid || !gdk_rectangle_equal(&old, &geom->rect)) {
+                geometry_serial++;
+        }
+}
+
+/**
+ * Widget moved to a new toplevel, so we need to start over
+ */
+static void budgie_geometry_widget_reparented(__budgie_unused__ GtkWidget *widget,
+                                              __budgie_unused__ GtkWidget *old_toplevel,
+                                              BudgieWidgetGeometry *geom)
+{
+        geom->valid = FALSE;
+        geometry_serial++;
+}
+
+/**
+ * budgie_geometry_cache_track:
+ * @widget: Widget to track
+ *
+ * Begin caching the screen geometry for @widget. Tracking is reference
+ * counted, so each call must be balanced with budgie_geometry_cache_untrack()
+ *
+ * This costs @widget its own size-allocate and hierarchy-changed handlers.
+ * Those are the only events that move it within its toplevel, and they are
+ * emitted on @widget alone, so no other widget pays for them.
+ */
+void budgie_geometry_cache_track(GtkWidget *widget)
+{
+        BudgieWidgetGeometry *geom = NULL;
+
+        g_return_if_fail(widget != NULL);
+
+        geom = g_object_get_qdata(G_OBJECT(widget), budgie_geometry_widget_quark());
+        if (geom) {
+                geom->refs++;
+                return;
+        }
+
+        geom = g_new0(BudgieWidgetGeometry, 1);
+        geom->refs = 1;
+        g_object_set_qdata_full(G_OBJECT(widget), budgie_geometry_widget_quark(), geom, g_free);
+
+        geom->allocate_id = g_signal_connect_after(widget,
+                                                   "size-allocate",
+                                                   G_CALLBACK(budgie_geometry_widget_allocated),
+                                                   geom);
+        geom->hierarchy_id = g_signal_connect(widget,
+                                              "hierarchy-changed",
+                                              G_CALLBACK(budgie_geometry_widget_reparented),
+                                              geom);
+}
+
+/**
+ * budgie_geometry_cache_untrack:
+ * @widget: Previously tracked widget
+ *
+ * Drop a tracking reference on @widget
+ */
+void budgie_geometry_cache_untrack(GtkWidget *widget)
+{
+        BudgieWidgetGeometry *geom = NULL;
+
+        g_return_if_fail(widget != NULL);
+
+        geom = g_object_get_qdata(G_OBJECT(widget), budgie_geometry_widget_quark());
+        if (!geom) {
+                return;
+        }
+
+        if (--geom->refs > 0) {
+                return;
+        }
+
+        g_signal_handler_disconnect(widget, geom->allocate_id);
+        g_signal_handler_disconnect(widget, geom->hierarchy_id);
+        g_object_set_qdata(G_OBJECT(widget), budgie_geometry_widget_quark(), NULL);
+}
+
+/**
+ * budgie_geometry_cache_is_tracked:
+ * @widget: Widget to check
+ *
+ * Returns: TRUE if anyone still holds a tracking reference on @widget, i.e.
+ * if its size-allocate and hierarchy-changed handlers are still connected
+ */
+gboolean budgie_geometry_cache_is_tracked(GtkWidget *widget)
+{
+        g_return_val_if_fail(widget != NULL, FALSE);
+
+        return g_object_get_qdata(G_OBJECT(widget), budgie_geometry_widget_quark()) != NULL;
+}
+
+/**
+ * Slow path for widgets we're not tracking: ask the toplevel where it is
+ */
+static gboolean budgie_geometry_compute_slow(GtkWidget *widget, GdkRectangle *target)
+{
+        GtkAllocation alloc = { 0 };
+        GtkWidget *toplevel = NULL;
+        GdkWindow *toplevel_window = NULL;
+        gint rx, ry = 0;
+        gint x, y = 0;
+
+        toplevel = gtk_widget_get_toplevel(widget);
+        toplevel_window = gtk_widget_get_window(toplevel);
+        if (!toplevel_window) {
+                return FALSE;
+        }
+
+        gdk_window_get_position(toplevel_window, &x, &y);
+        gtk_widget_translate_coordinates(widget, toplevel, x, y, &rx, &ry);
+        gtk_widget_get_allocation(widget, &alloc);
+
+        *target = (GdkRectangle){.x = rx, .y = ry, .width = alloc.width, .height = alloc.height };
+        return TRUE;
+}
+
+/**
+ * budgie_geometry_cache_get:
+ * @widget: Widget to find the geometry for
+ * @target: (out): Location to store the absolute screen geometry
+ *
+ * Determine where @widget lives on screen. Tracked widgets are served from
+ * the cache, and only the very first lookup for a toplevel that has not yet
+ * seen a configure-event will query its position.
+ *
+ * Returns: TRUE if @target was set
+ */
+gboolean budgie_geometry_cache_get(GtkWidget *widget, GdkRectangle *target)
+{
+        BudgieWidgetGeometry *geom = NULL;
+        BudgieToplevelGeometry *top = NULL;
+        GtkWidget *toplevel = NULL;
+        GdkWindow *toplevel_window = NULL;
+
+        g_return_val_if_fail(widget != NULL && target != NULL, FALSE);
+
+        geom = g_object_get_qdata(G_OBJECT(widget), budgie_geometry_widget_quark());
+        if (!geom) {
+                return budgie_geometry_compute_slow(widget, target);
+        }
+
+        if (!geom->valid || geom->layout_serial != layout_serial) {
+                budgie_geometry_update_widget(widget, geom);
+                if (!geom->valid) {
+                        return FALSE;
+                }
+        }
+
+        toplevel = gtk_widget_get_toplevel(widget);
+        top = budgie_geometry_get_toplevel(toplevel);
+        if (!top->valid) {
+                toplevel_window = gtk_widget_get_window(toplevel);
+                if (!toplevel_window) {
+                        return FALSE;
+                }
+                gdk_window_get_position(toplevel_window, &top->x, &top->y);
+                top->valid = TRUE;
+        }
+
+        *target = geom->rect;
+        target->x += top->x;
+        target->y += top->y;
+        return TRUE;
+}
+
+/**
+ * budgie_geometry_cache_get_serial:
+ *
+ * Returns: A counter that changes whenever any tracked geometry changes
+ */
+guint budgie_geometry_cache_get_serial(void)
+{
+        return geometry_serial;
+}
+
+/*
+ * Editor modelines  -  https://www.wireshark.org/tools/modelines.html
+ *
+ * Local variables:
+ * c-basic-offset: 8
+ * tab-width: 8
+ * indent-tabs-mode: nil
+ * End:
+ *
+ * vi: set shiftwidth=8 tabstop=8 expandtab:
+ * :indentSize=8:tabSize=8:noTabs=true:
+ */
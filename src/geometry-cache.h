@@ -0,0 +1,43 @@
+/*
+ * This file is part of ui-tests
+ *
+ * Copyright © 2016-2017 Ikey Doherty <ikey@solus-project.com>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ */
+
+#pragma once
+
+#include <gtk/gtk.h>
+
+G_BEGIN_DECLS
+
+/**
+ * The geometry cache keeps track of the absolute screen rectangle of a widget
+ * without needing to ask the display server. It is fed by size-allocate on
+ * the widget itself and configure-event on its toplevel window.
+ */
+
+void budgie_geometry_cache_track(GtkWidget *widget);
+void budgie_geometry_cache_untrack(GtkWidget *widget);
+gboolean budgie_geometry_cache_is_tracked(GtkWidget *widget);
+gboolean budgie_geometry_cache_get(GtkWidget *widget, GdkRectangle *target);
+guint budgie_geometry_cache_get_serial(void);
+
+G_END_DECLS
+
+/*
+ * Editor modelines  -  https://www.wireshark.org/tools/modelines.html
+ *
+ * Local variables:
+ * c-basic-offset: 8
+ * tab-width: 8
+ * indent-tabs-mode: nil
+ * End:
+ *
+ * vi: set shiftwidth=8 tabstop=8 expandtab:
+ * :indentSize=8:tabSize=8:noTabs=true:
+ */
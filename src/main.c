@@ -9,14 +9,82 @@
  * version 2.1 of the License, or (at your option) any later version.
  */
 
+#define _GNU_SOURCE
+
 #include "util.h"
+#include <errno.h>
 #include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
 
 BUDGIE_BEGIN_PEDANTIC
+#include "benchmark.h"
 #include "popover-manager.h"
 #include "popover.h"
 BUDGIE_END_PEDANTIC
 
+static gint benchmark_popovers = 0;
+static gint benchmark_churn = 0;
+static gboolean benchmark_blur = FALSE;
+static gboolean benchmark_dispatch = FALSE;
+static gboolean benchmark_lookup = FALSE;
+static gboolean benchmark_monitors = FALSE;
+static gint benchmark_iterations = 20;
+static gchar *benchmark_output = NULL;
+static gchar *benchmark_baseline = NULL;
+
+static GOptionEntry demo_options[] = {
+        { "benchmark", 0, 0, G_OPTION_ARG_INT, &benchmark_popovers,
+          "Benchmark with N popovers instead of running the demo", "N" },
+        { "churn", 0, 0, G_OPTION_ARG_INT, &benchmark_churn,
+          "Stress register/unregister churn with N random operations", "N" },
+        { "blur", 0, 0, G_OPTION_ARG_NONE, &benchmark_blur,
+          "Time the shadow blur kernel, then exit", NULL },
+        { "dispatch", 0, 0, G_OPTION_ARG_NONE, &benchmark_dispatch,
+          "Measure per-popover cost at 10, 100 and 1000 registrations", NULL },
+        { "lookup", 0, 0, G_OPTION_ARG_NONE, &benchmark_lookup,
+          "Time roll-over hit tests with 2 to 1000 registrations", NULL },
+        { "monitors", 0, 0, G_OPTION_ARG_NONE, &benchmark_monitors,
+          "Time placement across 1 to 8 synthetic monitors", NULL },
+        { "iterations", 0, 0, G_OPTION_ARG_INT, &benchmark_iterations,
+          "Number of benchmark iterations", "N" },
+        { "output", 0, 0, G_OPTION_ARG_FILENAME, &benchmark_output,
+          "Write the benchmark results here instead of stdout", "FILE" },
+        { "baseline", 0, 0, G_OPTION_ARG_FILENAME, &benchmark_baseline,
+          "Fail if the results regressed against this earlier run", "FILE" },
+        { NULL },
+};
+
+/**
+ * GObject only reads GOBJECT_DEBUG as it is loaded, so the churn run must
+ * start over with instance counting turned on for its leak checks to see
+ * anything at all
+ */
+static void budgie_popover_demo_count_instances(char **argv)
+{
+        const gchar *debug = g_getenv("GOBJECT_DEBUG");
+        gchar *flags = NULL;
+        gboolean churn = FALSE;
+
+        for (gint i = 1; argv[i]; i++) {
+                if (g_str_has_prefix(argv[i], "--churn")) {
+                        churn = TRUE;
+                        break;
+                }
+        }
+        if (!churn || (debug && strstr(debug, "instance-count"))) {
+                return;
+        }
+
+        flags = debug && *debug ? g_strconcat(debug, ",instance-count", NULL)
+                                : g_strdup("instance-count");
+        g_setenv("GOBJECT_DEBUG", flags, TRUE);
+        g_free(flags);
+
+        execv("/proc/self/exe", argv);
+        g_warning("Failed to restart with instance counting: %s", g_strerror(errno));
+}
+
 static void budgie_popover_demo_load_css(void)
 {
         GdkScreen *screen = NULL;
@@ -51,6 +119,34 @@ static gboolean show_popover_cb(__budgie_unused__ GtkWidget *window,
         return GDK_EVENT_STOP;
 }
 
+/**
+ * Widgets registered for shared content have no popover of their own, so
+ * ask the manager to show it for them
+ */
+static gboolean show_content_cb(GtkWidget *button, __budgie_unused__ GdkEventButton *event,
+                                gpointer udata)
+{
+        budgie_popover_manager_show_popover(udata, button);
+        return GDK_EVENT_STOP;
+}
+
+/**
+ * Build the content for the last demo button, only once it is first shown
+ */
+static GtkWidget *build_content_cb(__budgie_unused__ GtkWidget *parent_widget,
+                                   __budgie_unused__ gpointer udata)
+{
+        GDateTime *now = g_date_time_new_now_local();
+        gchar *markup = g_date_time_format(now, "<big>Built at %H:%M:%S</big>");
+        GtkWidget *label = gtk_label_new(markup);
+
+        gtk_label_set_use_markup(GTK_LABEL(label), TRUE);
+        g_free(markup);
+        g_date_time_unref(now);
+
+        return label;
+}
+
 static GtkWidget *sudo_make_me_a_popover(GtkWidget *relative_to, const gchar *le_label)
 {
         GtkWidget *popover = NULL;
@@ -89,13 +185,46 @@ static GtkWidget *sudo_make_me_a_popover(GtkWidget *relative_to, const gchar *le
 
 int main(int argc, char **argv)
 {
-        gtk_init(&argc, &argv);
+        GError *error = NULL;
+
+        budgie_popover_demo_count_instances(argv);
+
+        if (!gtk_init_with_args(&argc, &argv, NULL, demo_options, NULL, &error)) {
+                g_printerr("%s\n", error->message);
+                g_error_free(error);
+                return EXIT_FAILURE;
+        }
         GtkWidget *popover = NULL;
         BudgiePopoverManager *manager = NULL;
 
         /* Hacky demo */
         budgie_popover_demo_load_css();
 
+        /* i.e. xvfb-run -s "-screen 0 1920x1080x24" popover-test --benchmark=500 */
+        if (benchmark_popovers > 0) {
+                return budgie_popover_benchmark_run((guint)benchmark_popovers,
+                                                    (guint)MAX(benchmark_iterations, 1),
+                                                    benchmark_output,
+                                                    benchmark_baseline);
+        }
+        if (benchmark_churn > 0) {
+                return budgie_popover_benchmark_churn((guint)benchmark_churn, benchmark_output);
+        }
+        if (benchmark_blur) {
+                /* Each blur is quick, so take plenty of samples */
+                return budgie_popover_benchmark_blur((guint)MAX(benchmark_iterations, 1) * 50,
+                                                     benchmark_output);
+        }
+        if (benchmark_dispatch) {
+                return budgie_popover_benchmark_dispatch(benchmark_output);
+        }
+        if (benchmark_lookup) {
+                return budgie_popover_benchmark_lookup(benchmark_output);
+        }
+        if (benchmark_monitors) {
+                return budgie_popover_benchmark_monitors(benchmark_output);
+        }
+
         GtkWidget *main_window = NULL;
         GtkWidget *button, *layout = NULL;
 
@@ -128,6 +257,33 @@ int main(int argc, char **argv)
         g_signal_connect(button, "button-press-event", G_CALLBACK(show_popover_cb), popover);
         budgie_popover_manager_register_popover(manager, button, BUDGIE_POPOVER(popover));
 
+        /* These two share a single popover window, which just swaps content */
+        for (guint i = 3; i <= 4; i++) {
+                gchar *text = g_strdup_printf("Shared #%u", i);
+                gchar *markup = g_strdup_printf("<big>Shared content #%u</big>", i);
+                GtkWidget *content = gtk_label_new(markup);
+
+                gtk_label_set_use_markup(GTK_LABEL(content), TRUE);
+
+                button = gtk_button_new_with_label(text);
+                gtk_box_pack_start(GTK_BOX(layout), button, FALSE, FALSE, 0);
+                g_signal_connect(button,
+                                 "button-press-event",
+                                 G_CALLBACK(show_content_cb),
+                                 manager);
+                budgie_popover_manager_register_content(manager, button, content);
+
+                g_free(markup);
+                g_free(text);
+        }
+
+        /* Built on first show, and thrown away after being hidden for 10s */
+        button = gtk_button_new_with_label("Built on demand");
+        gtk_box_pack_start(GTK_BOX(layout), button, FALSE, FALSE, 0);
+        g_signal_connect(button, "button-press-event", G_CALLBACK(show_content_cb), manager);
+        budgie_popover_manager_register_factory(manager, button, build_content_cb, NULL, NULL);
+        budgie_popover_manager_set_content_timeout(manager, 10);
+
         g_signal_connect(main_window, "destroy", gtk_main_quit, NULL);
 
         gtk_widget_show_all(main_window);
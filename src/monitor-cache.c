@@ -0,0 +1,304 @@
+/*
+ * This file is part of ui-tests
+ *
+ * Copyright © 2016-2017 Ikey Doherty <ikey@solus-project.com>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ */
+
+#define _GNU_SOURCE
+
+#include "util.h"
+
+BUDGIE_BEGIN_PEDANTIC
+#include "monitor-cache.h"
+#include <gtk/gtk.h>
+BUDGIE_END_PEDANTIC
+
+/**
+ * Per-screen table of monitors. This lives for as long as the screen does.
+ */
+typedef struct BudgieMonitorTable {
+        GdkScreen *screen;
+        GArray *monitors; /* BudgieMonitorInfo */
+#if GTK_CHECK_VERSION(3, 22, 0)
+        GPtrArray *watched; /* GdkMonitor we have notify handlers on */
+#endif
+        gboolean valid;
+} BudgieMonitorTable;
+
+static GQuark budgie_monitor_table_quark(void)
+{
+        static GQuark quark = 0;
+
+        if (G_UNLIKELY(quark == 0)) {
+                quark = g_quark_from_static_string("budgie-monitor-table");
+        }
+        return quark;
+}
+
+static void budgie_monitor_table_invalidate(BudgieMonitorTable *table)
+{
+        table->valid = FALSE;
+}
+
+#if GTK_CHECK_VERSION(3, 22, 0)
+static void budgie_monitor_table_monitor_notify(__budgie_unused__ GObject *monitor,
+                                                __budgie_unused__ GParamSpec *spec,
+                                                BudgieMonitorTable *table)
+{
+        budgie_monitor_table_invalidate(table);
+}
+
+static void budgie_monitor_table_monitors_changed(__budgie_unused__ GdkDisplay *display,
+                                                  __budgie_unused__ GdkMonitor *monitor,
+                                                  BudgieMonitorTable *table)
+{
+        budgie_monitor_table_invalidate(table);
+}
+
+/**
+ * Stop listening to the monitors from the last rebuild
+ */
+static void budgie_monitor_table_unwatch(BudgieMonitorTable *table)
+{
+        for (guint i = 0; i < table->watched->len; i++) {
+                GObject *monitor = g_ptr_array_index(table->watched, i);
+                g_signal_handlers_disconnect_by_data(monitor, table);
+        }
+        g_ptr_array_set_size(table->watched, 0);
+}
+#else
+static void budgie_monitor_table_screen_changed(__budgie_unused__ GdkScreen *screen,
+                                                BudgieMonitorTable *table)
+{
+        budgie_monitor_table_invalidate(table);
+}
+#endif
+
+static void budgie_monitor_table_free(BudgieMonitorTable *table)
+{
+#if GTK_CHECK_VERSION(3, 22, 0)
+        budgie_monitor_table_unwatch(table);
+        g_signal_handlers_disconnect_by_data(gdk_screen_get_display(table->screen), table);
+        g_ptr_array_unref(table->watched);
+#endif
+        g_array_unref(table->monitors);
+        g_free(table);
+}
+
+/**
+ * Find (or start tracking) the monitors for @screen
+ */
+static BudgieMonitorTable *budgie_monitor_get_table(GdkScreen *screen)
+{
+        BudgieMonitorTable *table = NULL;
+
+        table = g_object_get_qdata(G_OBJECT(screen), budgie_monitor_table_quark());
+        if (table) {
+                return table;
+        }
+
+        table = g_new0(BudgieMonitorTable, 1);
+        table->screen = screen;
+        table->monitors = g_array_new(FALSE, TRUE, sizeof(BudgieMonitorInfo));
+        g_object_set_qdata_full(G_OBJECT(screen),
+                                budgie_monitor_table_quark(),
+                                table,
+                                (GDestroyNotify)budgie_monitor_table_free);
+
+#if GTK_CHECK_VERSION(3, 22, 0)
+        GdkDisplay *display = gdk_screen_get_display(screen);
+
+        /* The monitors are owned by the display, we only watch them */
+        table->watched = g_ptr_array_new_with_free_func(g_object_unref);
+        g_signal_connect(display,
+                         "monitor-added",
+                         G_CALLBACK(budgie_monitor_table_monitors_changed),
+                         table);
+        g_signal_connect(display,
+                         "monitor-removed",
+                         G_CALLBACK(budgie_monitor_table_monitors_changed),
+                         table);
+#else
+        g_signal_connect(screen,
+                         "monitors-changed",
+                         G_CALLBACK(budgie_monitor_table_screen_changed),
+                         table);
+        g_signal_connect(screen,
+                         "size-changed",
+                         G_CALLBACK(budgie_monitor_table_screen_changed),
+                         table);
+#endif
+        return table;
+}
+
+/**
+ * Re-read every monitor on the screen. Only happens after an invalidation.
+ */
+static void budgie_monitor_table_rebuild(BudgieMonitorTable *table)
+{
+        BudgieMonitorInfo info = { 0 };
+        gint n_monitors = 0;
+
+        g_array_set_size(table->monitors, 0);
+
+#if GTK_CHECK_VERSION(3, 22, 0)
+        GdkDisplay *display = gdk_screen_get_display(table->screen);
+
+        budgie_monitor_table_unwatch(table);
+
+        n_monitors = gdk_display_get_n_monitors(display);
+        for (gint i = 0; i < n_monitors; i++) {
+                GdkMonitor *monitor = gdk_display_get_monitor(display, i);
+
+                gdk_monitor_get_geometry(monitor, &info.geometry);
+                gdk_monitor_get_workarea(monitor, &info.workarea);
+                g_array_append_val(table->monitors, info);
+
+                g_ptr_array_add(table->watched, g_object_ref(monitor));
+                g_signal_connect(monitor,
+                                 "notify::geometry",
+                                 G_CALLBACK(budgie_monitor_table_monitor_notify),
+                                 table);
+                g_signal_connect(monitor,
+                                 "notify::workarea",
+                                 G_CALLBACK(budgie_monitor_table_monitor_notify),
+                                 table);
+        }
+#else
+        n_monitors = gdk_screen_get_n_monitors(table->screen);
+        for (gint i = 0; i < n_monitors; i++) {
+                gdk_screen_get_monitor_geometry(table->screen, i, &info.geometry);
+                gdk_screen_get_monitor_workarea(table->screen, i, &info.workarea);
+                g_array_append_val(table->monitors, info);
+        }
+#endif
+
+        table->valid = TRUE;
+}
+
+/**
+ * Squared distance from the centre of @rect to the nearest point of @monitor
+ */
+static gint64 budgie_monitor_distance(const GdkRectangle *monitor, const GdkRectangle *rect)
+{
+        gint64 cx = rect->x + rect->width / 2;
+        gint64 cy = rect->y + rect->height / 2;
+        gint64 dx = 0, dy = 0;
+
+        if (cx < monitor->x) {
+                dx = monitor->x - cx;
+        } else if (cx >= monitor->x + monitor->width) {
+                dx = cx - (monitor->x + monitor->width - 1);
+        }
+        if (cy < monitor->y) {
+                dy = monitor->y - cy;
+        } else if (cy >= monitor->y + monitor->height) {
+                dy = cy - (monitor->y + monitor->height - 1);
+        }
+
+        return dx * dx + dy * dy;
+}
+
+/**
+ * budgie_monitor_find:
+ * @monitors: Table of monitors to search
+ * @n_monitors: Number of entries in @monitors
+ * @rect: Absolute screen rectangle, typically the anchor widget
+ *
+ * Find the monitor that @rect overlaps the most, or failing that, the one
+ * closest to it
+ *
+ * Returns: (nullable): The matching monitor, or NULL if @n_monitors is 0
+ */
+const BudgieMonitorInfo *budgie_monitor_find(const BudgieMonitorInfo *monitors, guint n_monitors,
+                                             const GdkRectangle *rect)
+{
+        const BudgieMonitorInfo *best = NULL;
+        gint64 best_area = 0;
+        gint64 best_distance = G_MAXINT64;
+
+        /* Most overlap wins */
+        for (guint i = 0; i < n_monitors; i++) {
+                const BudgieMonitorInfo *m = &monitors[i];
+                GdkRectangle overlap = { 0 };
+                gint64 area = 0;
+
+                if (!gdk_rectangle_intersect(&m->geometry, rect, &overlap)) {
+                        continue;
+                }
+                area = (gint64)overlap.width * overlap.height;
+                if (area > best_area) {
+                        best_area = area;
+                        best = m;
+                }
+        }
+        if (best) {
+                return best;
+        }
+
+        /* Nothing overlapping, so go for the nearest one */
+        for (guint i = 0; i < n_monitors; i++) {
+                gint64 distance = budgie_monitor_distance(&monitors[i].geometry, rect);
+
+                if (distance < best_distance) {
+                        best_distance = distance;
+                        best = &monitors[i];
+                }
+        }
+
+        return best;
+}
+
+/**
+ * budgie_monitor_cache_lookup:
+ * @screen: Screen that @rect lives on
+ * @rect: Absolute screen rectangle, typically the anchor widget
+ * @info: (out): Location to store the monitor geometry and workarea
+ *
+ * Find the monitor that @rect overlaps the most, or failing that, the one
+ * closest to it. This matches what GDK does for windows, without asking the
+ * display server.
+ *
+ * Returns: TRUE if @info was set
+ */
+gboolean budgie_monitor_cache_lookup(GdkScreen *screen, const GdkRectangle *rect,
+                                     BudgieMonitorInfo *info)
+{
+        BudgieMonitorTable *table = NULL;
+        const BudgieMonitorInfo *best = NULL;
+
+        g_return_val_if_fail(screen != NULL && rect != NULL && info != NULL, FALSE);
+
+        table = budgie_monitor_get_table(screen);
+        if (!table->valid) {
+                budgie_monitor_table_rebuild(table);
+        }
+
+        best = budgie_monitor_find((const BudgieMonitorInfo *)(gpointer)table->monitors->data,
+                                   table->monitors->len,
+                                   rect);
+        if (!best) {
+                return FALSE;
+        }
+
+        *info = *best;
+        return TRUE;
+}
+
+/*
+ * Editor modelines  -  https://www.wireshark.org/tools/modelines.html
+ *
+ * Local variables:
+ * c-basic-offset: 8
+ * tab-width: 8
+ * indent-tabs-mode: nil
+ * End:
+ *
+ * vi: set shiftwidth=8 tabstop=8 expandtab:
+ * :indentSize=8:tabSize=8:noTabs=true:
+ */
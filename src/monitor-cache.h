@@ -0,0 +1,47 @@
+/*
+ * This file is part of ui-tests
+ *
+ * Copyright © 2016-2017 Ikey Doherty <ikey@solus-project.com>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ */
+
+#pragma once
+
+#include <gtk/gtk.h>
+
+G_BEGIN_DECLS
+
+/**
+ * The monitor cache keeps one table of monitor geometry per screen, shared
+ * by every popover. It is only rebuilt when monitors are added, removed or
+ * change their geometry, so lookups never need to talk to the display server.
+ */
+
+typedef struct BudgieMonitorInfo {
+        GdkRectangle geometry;
+        GdkRectangle workarea;
+} BudgieMonitorInfo;
+
+const BudgieMonitorInfo *budgie_monitor_find(const BudgieMonitorInfo *monitors, guint n_monitors,
+                                             const GdkRectangle *rect);
+gboolean budgie_monitor_cache_lookup(GdkScreen *screen, const GdkRectangle *rect,
+                                     BudgieMonitorInfo *info);
+
+G_END_DECLS
+
+/*
+ * Editor modelines  -  https://www.wireshark.org/tools/modelines.html
+ *
+ * Local variables:
+ * c-basic-offset: 8
+ * tab-width: 8
+ * indent-tabs-mode: nil
+ * End:
+ *
+ * vi: set shiftwidth=8 tabstop=8 expandtab:
+ * :indentSize=8:tabSize=8:noTabs=true:
+ */
@@ -0,0 +1,301 @@
+/*
+ * This file is part of ui-tests
+ *
+ * Copyright © 2016-2017 Ikey Doherty <ikey@solus-project.com>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ */
+
+#include "util.h"
+#include <string.h>
+
+BUDGIE_BEGIN_PEDANTIC
+#include "popover-placement.h"
+#include <glib.h>
+BUDGIE_END_PEDANTIC
+
+/**
+ * Number of random inputs checked by each property
+ */
+#define PLACEMENT_CASES 200000
+
+/**
+ * Number of placements timed by the performance run
+ */
+#define PLACEMENT_PERF_RUNS 2000000
+
+/**
+ * Distinct inputs cycled through when checking the memo, so that it sees
+ * both repeats and evictions
+ */
+#define PLACEMENT_MEMO_POOL 6
+
+/**
+ * Pick a coordinate along an edge of @start, @length: hugging either end,
+ * where panels live, or anywhere in between
+ */
+static gint budgie_placement_random_along(GRand *rand, gint start, gint length, gint size)
+{
+        switch (g_rand_int_range(rand, 0, 3)) {
+        case 0:
+                return start + g_rand_int_range(rand, -size, 8);
+        case 1:
+                return start + length - size + g_rand_int_range(rand, -8, size);
+        default:
+                return start + g_rand_int_range(rand, 0, length);
+        }
+}
+
+/**
+ * Fill @input with a random monitor anywhere in a multi-head layout, i.e.
+ * with negative offsets too, and an anchor on or around it
+ */
+static void budgie_placement_random_input(GRand *rand, BudgiePlacementInput *input)
+{
+        BudgiePlacementRect *monitor = &input->monitor;
+        BudgiePlacementRect *anchor = &input->anchor;
+
+        /* Zeroed first, as the memo compares inputs directly */
+        memset(input, 0, sizeof(*input));
+
+        monitor->x = g_rand_int_range(rand, -8000, 8000);
+        monitor->y = g_rand_int_range(rand, -4000, 4000);
+        monitor->width = g_rand_int_range(rand, 640, 3841);
+        monitor->height = g_rand_int_range(rand, 480, 2161);
+
+        anchor->width = g_rand_int_range(rand, 1, 200);
+        anchor->height = g_rand_int_range(rand, 1, 200);
+        anchor->x = budgie_placement_random_along(rand, monitor->x, monitor->width, anchor->width);
+        anchor->y =
+            budgie_placement_random_along(rand, monitor->y, monitor->height, anchor->height);
+
+        /* Occasionally larger than the monitor itself */
+        input->width = g_rand_int_range(rand, 1, monitor->width + 100);
+        input->height = g_rand_int_range(rand, 1, monitor->height + 100);
+
+        input->automatic = g_rand_boolean(rand);
+        input->edge = (BudgiePlacementEdge)g_rand_int_range(rand,
+                                                            BUDGIE_PLACEMENT_EDGE_LEFT,
+                                                            BUDGIE_PLACEMENT_EDGE_BOTTOM + 1);
+        input->tail_dimension = 2 * g_rand_int_range(rand, 0, 17);
+        input->shadow_dimension = g_rand_int_range(rand, 0, 9);
+}
+
+/**
+ * Compare two placements field by field, as BudgieTail has padding
+ */
+static void budgie_placement_assert_equal(const BudgiePlacement *a, const BudgiePlacement *b)
+{
+        g_assert_cmpint(a->x, ==, b->x);
+        g_assert_cmpint(a->y, ==, b->y);
+        g_assert_cmpint(a->margin.top, ==, b->margin.top);
+        g_assert_cmpint(a->margin.bottom, ==, b->margin.bottom);
+        g_assert_cmpint(a->margin.start, ==, b->margin.start);
+        g_assert_cmpint(a->margin.end, ==, b->margin.end);
+        g_assert_cmpint(a->tail.position, ==, b->tail.position);
+        g_assert_cmpfloat(a->tail.start_x, ==, b->tail.start_x);
+        g_assert_cmpfloat(a->tail.start_y, ==, b->tail.start_y);
+        g_assert_cmpfloat(a->tail.end_x, ==, b->tail.end_x);
+        g_assert_cmpfloat(a->tail.end_y, ==, b->tail.end_y);
+        g_assert_cmpfloat(a->tail.x, ==, b->tail.x);
+        g_assert_cmpfloat(a->tail.y, ==, b->tail.y);
+        g_assert_cmpfloat(a->tail.x_offset, ==, b->tail.x_offset);
+        g_assert_cmpfloat(a->tail.y_offset, ==, b->tail.y_offset);
+}
+
+/**
+ * The documented behaviour of budgie_placement_compute(): the toplevel hint
+ * is obeyed, automatic placement prefers going underneath, the window stays
+ * on its monitor whenever it is small enough to fit, and the tail always
+ * points somewhere on that monitor.
+ */
+static void test_placement_invariants(void)
+{
+        GRand *rand = g_rand_new_with_seed(6);
+
+        for (guint i = 0; i < PLACEMENT_CASES; i++) {
+                BudgiePlacementInput input;
+                BudgiePlacement placement;
+                BudgiePlacement dirty;
+                const BudgiePlacementRect *monitor = &input.monitor;
+                const BudgiePlacementRect *anchor = &input.anchor;
+                gint below = 0;
+                gdouble tail_x, tail_y = 0;
+
+                budgie_placement_random_input(rand, &input);
+                memset(&placement, 0, sizeof(placement));
+                budgie_placement_compute(&input, &placement);
+
+                /* Nothing is carried over from the previous contents */
+                memset(&dirty, 0xA5, sizeof(dirty));
+                budgie_placement_compute(&input, &dirty);
+                budgie_placement_assert_equal(&placement, &dirty);
+
+                if (!input.automatic) {
+                        g_assert_cmpint(placement.tail.position, ==, input.edge);
+                } else {
+                        below = anchor->y + anchor->height + input.tail_dimension / 2 +
+                                input.shadow_dimension + input.height;
+                        if (below <= monitor->y + monitor->height) {
+                                g_assert_cmpint(placement.tail.position,
+                                                ==,
+                                                BUDGIE_PLACEMENT_EDGE_TOP);
+                        }
+                }
+
+                if (input.width < monitor->width) {
+                        g_assert_cmpint(placement.x, >=, monitor->x);
+                        g_assert_cmpint(placement.x + input.width,
+                                        <=,
+                                        monitor->x + monitor->width);
+                }
+                if (input.height < monitor->height) {
+                        g_assert_cmpint(placement.y, >=, monitor->y);
+                        g_assert_cmpint(placement.y + input.height,
+                                        <=,
+                                        monitor->y + monitor->height);
+                }
+
+                /* The tail points at something on the same monitor */
+                tail_x = placement.x + placement.tail.x + placement.tail.x_offset;
+                tail_y = placement.y + placement.tail.y + placement.tail.y_offset;
+                g_assert_cmpfloat(tail_x, >=, monitor->x);
+                g_assert_cmpfloat(tail_x, <=, monitor->x + monitor->width);
+                g_assert_cmpfloat(tail_y, >=, monitor->y);
+                g_assert_cmpfloat(tail_y, <=, monitor->y + monitor->height);
+        }
+
+        g_rand_free(rand);
+}
+
+/**
+ * Moving the anchor and its monitor together, i.e. to another head of a
+ * multi-monitor layout, only moves the window
+ */
+static void test_placement_translation(void)
+{
+        GRand *rand = g_rand_new_with_seed(7);
+
+        for (guint i = 0; i < PLACEMENT_CASES; i++) {
+                BudgiePlacementInput input;
+                BudgiePlacement placement;
+                BudgiePlacement moved;
+                gint dx = g_rand_int_range(rand, -8000, 8000);
+                gint dy = g_rand_int_range(rand, -4000, 4000);
+
+                budgie_placement_random_input(rand, &input);
+                budgie_placement_compute(&input, &placement);
+
+                input.anchor.x += dx;
+                input.anchor.y += dy;
+                input.monitor.x += dx;
+                input.monitor.y += dy;
+                budgie_placement_compute(&input, &moved);
+
+                moved.x -= dx;
+                moved.y -= dy;
+                budgie_placement_assert_equal(&placement, &moved);
+        }
+
+        g_rand_free(rand);
+}
+
+/**
+ * The memo must always hand back exactly what a fresh computation would
+ */
+static void test_placement_memo(void)
+{
+        BudgiePlacementInput pool[PLACEMENT_MEMO_POOL];
+        BudgiePlacementMemo memo;
+        GRand *rand = g_rand_new_with_seed(8);
+        guint hits = 0;
+        guint misses = 0;
+
+        memset(&memo, 0, sizeof(memo));
+        for (guint i = 0; i < G_N_ELEMENTS(pool); i++) {
+                budgie_placement_random_input(rand, &pool[i]);
+        }
+
+        for (guint i = 0; i < PLACEMENT_CASES; i++) {
+                BudgiePlacementInput *input = &pool[g_rand_int_range(rand, 0, PLACEMENT_MEMO_POOL)];
+                BudgiePlacement fresh;
+                BudgiePlacement memoised;
+
+                /* Now and then the popover resizes, or the anchor moves */
+                if (g_rand_int_range(rand, 0, 16) == 0) {
+                        budgie_placement_random_input(rand, input);
+                }
+
+                budgie_placement_compute(input, &fresh);
+                if (budgie_placement_memo_compute(&memo, input, &memoised)) {
+                        hits++;
+                } else {
+                        misses++;
+                }
+                budgie_placement_assert_equal(&fresh, &memoised);
+        }
+
+        g_assert_cmpuint(hits, >, 0);
+        g_assert_cmpuint(misses, >, 0);
+
+        g_rand_free(rand);
+}
+
+/**
+ * Placements per second, only run with -m perf (i.e. meson benchmark)
+ */
+static void test_placement_perf(void)
+{
+        BudgiePlacementInput inputs[64];
+        GRand *rand = g_rand_new_with_seed(9);
+        volatile gint sink = 0;
+        gdouble elapsed = 0;
+
+        for (guint i = 0; i < G_N_ELEMENTS(inputs); i++) {
+                budgie_placement_random_input(rand, &inputs[i]);
+        }
+
+        g_test_timer_start();
+        for (guint i = 0; i < PLACEMENT_PERF_RUNS; i++) {
+                BudgiePlacement placement;
+
+                budgie_placement_compute(&inputs[i % G_N_ELEMENTS(inputs)], &placement);
+                sink += placement.x;
+        }
+        elapsed = g_test_timer_elapsed();
+
+        g_test_maximized_result(PLACEMENT_PERF_RUNS / elapsed,
+                                "%.0f placements per second",
+                                PLACEMENT_PERF_RUNS / elapsed);
+        g_rand_free(rand);
+}
+
+int main(int argc, char **argv)
+{
+        g_test_init(&argc, &argv, NULL);
+
+        g_test_add_func("/placement/invariants", test_placement_invariants);
+        g_test_add_func("/placement/translation", test_placement_translation);
+        g_test_add_func("/placement/memo", test_placement_memo);
+        if (g_test_perf()) {
+                g_test_add_func("/placement/perf", test_placement_perf);
+        }
+
+        return g_test_run();
+}
+
+/*
+ * Editor modelines  -  https://www.wireshark.org/tools/modelines.html
+ *
+ * Local variables:
+ * c-basic-offset: 8
+ * tab-width: 8
+ * indent-tabs-mode: nil
+ * End:
+ *
+ * vi: set shiftwidth=8 tabstop=8 expandtab:
+ * :indentSize=8:tabSize=8:noTabs=true:
+ */
@@ -0,0 +1,279 @@
+/*
+ * This file is part of ui-tests
+ *
+ * Copyright © 2016-2017 Ikey Doherty <ikey@solus-project.com>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ */
+
+#define _GNU_SOURCE
+
+#include "util.h"
+
+BUDGIE_BEGIN_PEDANTIC
+#include "popover-chrome.h"
+#include <gtk/gtk.h>
+BUDGIE_END_PEDANTIC
+
+/**
+ * One template per tail position. Each template is the smallest popover we
+ * can render that still has distinct corners, a 1px stretchable edge and
+ * centre, and room for the tail without touching the corners:
+ *
+ *      K | 1 | 2P + 2 (tail) | K      along the tail edge
+ *      K | 1 | K                      across it
+ *
+ * Everything is sampled from the 1px row/column at offset K, which is always
+ * clear of the tail gap.
+ */
+struct BudgieChromeSlices {
+        BudgieChromeRenderFunc render;
+        gpointer udata;
+        cairo_surface_t *templates[4];
+        gint corner_extent; /* K */
+        gint tail_extent;   /* P */
+};
+
+/**
+ * budgie_chrome_slices_new:
+ * @render: Function used to rasterise each template
+ * @udata: User data for @render
+ *
+ * Returns: (transfer full): A new slice cache, freed with budgie_chrome_slices_free()
+ */
+BudgieChromeSlices *budgie_chrome_slices_new(BudgieChromeRenderFunc render, gpointer udata)
+{
+        BudgieChromeSlices *slices = NULL;
+
+        slices = g_new0(BudgieChromeSlices, 1);
+        slices->render = render;
+        slices->udata = udata;
+        return slices;
+}
+
+/**
+ * budgie_chrome_slices_free:
+ *
+ * Free the slice cache and any templates it holds
+ */
+void budgie_chrome_slices_free(BudgieChromeSlices *slices)
+{
+        if (!slices) {
+                return;
+        }
+        budgie_chrome_slices_invalidate(slices, 0, 0);
+        g_free(slices);
+}
+
+/**
+ * budgie_chrome_slices_invalidate:
+ * @corner_extent: Size of each corner slice, including shadow and radius
+ * @tail_extent: Half the length of the tail slice along its edge
+ *
+ * Drop all templates, i.e. because the style changed. They're re-rendered
+ * lazily on the next compose.
+ */
+void budgie_chrome_slices_invalidate(BudgieChromeSlices *slices, gint corner_extent,
+                                     gint tail_extent)
+{
+        for (guint i = 0; i < G_N_ELEMENTS(slices->templates); i++) {
+                g_clear_pointer(&slices->templates[i], cairo_surface_destroy);
+        }
+        slices->corner_extent = corner_extent;
+        slices->tail_extent = tail_extent;
+}
+
+/**
+ * Work out the template size for the given tail position
+ */
+static void budgie_chrome_template_size(BudgieChromeSlices *slices, GtkPositionType position,
+                                        gint *width, gint *height)
+{
+        gint k = slices->corner_extent;
+        gint p = slices->tail_extent;
+
+        switch (position) {
+        case GTK_POS_LEFT:
+        case GTK_POS_RIGHT:
+                *width = (2 * k) + 1;
+                *height = (2 * k) + 1 + (2 * p) + 2;
+                break;
+        case GTK_POS_TOP:
+        case GTK_POS_BOTTOM:
+        default:
+                *width = (2 * k) + 1 + (2 * p) + 2;
+                *height = (2 * k) + 1;
+                break;
+        }
+}
+
+/**
+ * Rasterise the template for this tail position if we don't already have it
+ */
+static cairo_surface_t *budgie_chrome_get_template(BudgieChromeSlices *slices, GdkWindow *window,
+                                                   GtkPositionType position)
+{
+        GtkAllocation alloc = { 0 };
+        cairo_t *cr = NULL;
+
+        if (slices->templates[position]) {
+                return slices->templates[position];
+        }
+
+        budgie_chrome_template_size(slices, position, &alloc.width, &alloc.height);
+        slices->templates[position] = gdk_window_create_similar_surface(window,
+                                                                        CAIRO_CONTENT_COLOR_ALPHA,
+                                                                        alloc.width,
+                                                                        alloc.height);
+        cr = cairo_create(slices->templates[position]);
+        slices->render(cr, position, &alloc, slices->udata);
+        cairo_destroy(cr);
+
+        return slices->templates[position];
+}
+
+/**
+ * Copy the source rectangle into the destination rectangle, stretching it
+ * as required. Sources are either 1px wide strips or same-sized regions so
+ * nearest neighbour filtering is exact.
+ */
+static void budgie_chrome_blit(cairo_t *cr, cairo_surface_t *source, double sx, double sy,
+                               double sw, double sh, double dx, double dy, double dw, double dh)
+{
+        if (dw <= 0 || dh <= 0) {
+                return;
+        }
+
+        cairo_save(cr);
+        cairo_rectangle(cr, dx, dy, dw, dh);
+        cairo_clip(cr);
+        cairo_translate(cr, dx, dy);
+        cairo_scale(cr, dw / sw, dh / sh);
+        cairo_set_source_surface(cr, source, -sx, -sy);
+        cairo_pattern_set_filter(cairo_get_source(cr), CAIRO_FILTER_NEAREST);
+        cairo_paint(cr);
+        cairo_restore(cr);
+}
+
+/**
+ * budgie_chrome_slices_compose:
+ * @window: Window that the templates should be similar to
+ * @cr: Context to compose into, with the popover origin at 0, 0
+ * @position: Position of the tail
+ * @width: Width of the popover
+ * @height: Height of the popover
+ * @tail_centre: Centre of the tail along its edge, including any offset
+ *
+ * Build the chrome for a popover of any size from the cached slices. This is
+ * a handful of blits instead of a full CSS render.
+ *
+ * Returns: FALSE if the popover is too small, or the tail too close to a
+ * corner, to be composed. The caller should render the chrome directly.
+ */
+gboolean budgie_chrome_slices_compose(BudgieChromeSlices *slices, GdkWindow *window, cairo_t *cr,
+                                      GtkPositionType position, gint width, gint height,
+                                      double tail_centre)
+{
+        cairo_surface_t *tpl = NULL;
+        gint k = slices->corner_extent;
+        gint p = slices->tail_extent;
+        gint tw, th = 0;
+        gint mw, mh = 0;
+        gint tail_at = 0;
+        gint tpl_tail_at = 0;
+
+        if (k <= 0 || width < (2 * k) + 1 || height < (2 * k) + 1) {
+                return FALSE;
+        }
+
+        /* Tail patch must sit entirely on the stretched edge */
+        tail_at = (gint)(tail_centre + 0.5);
+        if (position == GTK_POS_LEFT || position == GTK_POS_RIGHT) {
+                if (tail_at - p < k || tail_at + p > height - k) {
+                        return FALSE;
+                }
+        } else if (tail_at - p < k || tail_at + p > width - k) {
+                return FALSE;
+        }
+
+        tpl = budgie_chrome_get_template(slices, window, position);
+        budgie_chrome_template_size(slices, position, &tw, &th);
+        mw = width - (2 * k);
+        mh = height - (2 * k);
+
+        cairo_save(cr);
+        cairo_set_operator(cr, CAIRO_OPERATOR_SOURCE);
+
+        /* Corners */
+        budgie_chrome_blit(cr, tpl, 0, 0, k, k, 0, 0, k, k);
+        budgie_chrome_blit(cr, tpl, tw - k, 0, k, k, width - k, 0, k, k);
+        budgie_chrome_blit(cr, tpl, 0, th - k, k, k, 0, height - k, k, k);
+        budgie_chrome_blit(cr, tpl, tw - k, th - k, k, k, width - k, height - k, k, k);
+
+        /* Edges, stretched from the 1px strip at K */
+        budgie_chrome_blit(cr, tpl, k, 0, 1, k, k, 0, mw, k);
+        budgie_chrome_blit(cr, tpl, k, th - k, 1, k, k, height - k, mw, k);
+        budgie_chrome_blit(cr, tpl, 0, k, k, 1, 0, k, k, mh);
+        budgie_chrome_blit(cr, tpl, tw - k, k, k, 1, width - k, k, k, mh);
+
+        /* Centre */
+        budgie_chrome_blit(cr, tpl, k, k, 1, 1, k, k, mw, mh);
+
+        /* Tail, lifted from the centre of the template edge */
+        switch (position) {
+        case GTK_POS_LEFT:
+                tpl_tail_at = th / 2;
+                budgie_chrome_blit(cr, tpl, 0, tpl_tail_at - p, k, 2 * p, 0, tail_at - p, k, 2 * p);
+                break;
+        case GTK_POS_RIGHT:
+                tpl_tail_at = th / 2;
+                budgie_chrome_blit(cr,
+                                   tpl,
+                                   tw - k,
+                                   tpl_tail_at - p,
+                                   k,
+                                   2 * p,
+                                   width - k,
+                                   tail_at - p,
+                                   k,
+                                   2 * p);
+                break;
+        case GTK_POS_TOP:
+                tpl_tail_at = tw / 2;
+                budgie_chrome_blit(cr, tpl, tpl_tail_at - p, 0, 2 * p, k, tail_at - p, 0, 2 * p, k);
+                break;
+        case GTK_POS_BOTTOM:
+        default:
+                tpl_tail_at = tw / 2;
+                budgie_chrome_blit(cr,
+                                   tpl,
+                                   tpl_tail_at - p,
+                                   th - k,
+                                   2 * p,
+                                   k,
+                                   tail_at - p,
+                                   height - k,
+                                   2 * p,
+                                   k);
+                break;
+        }
+
+        cairo_restore(cr);
+        return TRUE;
+}
+
+/*
+ * Editor modelines  -  https://www.wireshark.org/tools/modelines.html
+ *
+ * Local variables:
+ * c-basic-offset: 8
+ * tab-width: 8
+ * indent-tabs-mode: nil
+ * End:
+ *
+ * vi: set shiftwidth=8 tabstop=8 expandtab:
+ * :indentSize=8:tabSize=8:noTabs=true:
+ */
@@ -0,0 +1,48 @@
+/*
+ * This file is part of ui-tests
+ *
+ * Copyright © 2016-2017 Ikey Doherty <ikey@solus-project.com>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ */
+
+#pragma once
+
+#include <gtk/gtk.h>
+
+G_BEGIN_DECLS
+
+typedef struct BudgieChromeSlices BudgieChromeSlices;
+
+/**
+ * Render the full chrome for a popover of the given size into @cr. The tail
+ * must be centred along the @position edge, with no offset applied.
+ */
+typedef void (*BudgieChromeRenderFunc)(cairo_t *cr, GtkPositionType position,
+                                       GtkAllocation *alloc, gpointer udata);
+
+BudgieChromeSlices *budgie_chrome_slices_new(BudgieChromeRenderFunc render, gpointer udata);
+void budgie_chrome_slices_free(BudgieChromeSlices *slices);
+void budgie_chrome_slices_invalidate(BudgieChromeSlices *slices, gint corner_extent,
+                                     gint tail_extent);
+gboolean budgie_chrome_slices_compose(BudgieChromeSlices *slices, GdkWindow *window, cairo_t *cr,
+                                      GtkPositionType position, gint width, gint height,
+                                      double tail_centre);
+
+G_END_DECLS
+
+/*
+ * Editor modelines  -  https://www.wireshark.org/tools/modelines.html
+ *
+ * Local variables:
+ * c-basic-offset: 8
+ * tab-width: 8
+ * indent-tabs-mode: nil
+ * End:
+ *
+ * vi: set shiftwidth=8 tabstop=8 expandtab:
+ * :indentSize=8:tabSize=8:noTabs=true:
+ */
@@ -14,10 +14,65 @@
 #include "util.h"
 
 BUDGIE_BEGIN_PEDANTIC
+#include "geometry-cache.h"
 #include "popover-manager.h"
+#include "popover-private.h"
+#include <glib-unix.h>
 #include <gtk/gtk.h>
+#include <signal.h>
 BUDGIE_END_PEDANTIC
 
+/**
+ * Width and height of each cell in the roll-over index. Panel applets tend to
+ * be somewhere between 24 and 64 pixels in size, so any given cell only ever
+ * references a handful of registered widgets.
+ */
+#define INDEX_CELL_SIZE 64
+
+/**
+ * Default number of hidden popovers we'll keep realized and measured. This
+ * covers the open popover plus a neighbour on each side of it.
+ */
+#define WARM_BUDGET_DEFAULT 6
+
+/**
+ * Default number of seconds that factory-built content may stay hidden
+ * before it is thrown away again
+ */
+#define CONTENT_TIMEOUT_DEFAULT 30
+
+/**
+ * Pending shows run ahead of GTK's relayout and redraw so that they can't be
+ * starved by them.
+ */
+#define SHOW_PRIORITY G_PRIORITY_HIGH_IDLE
+
+/**
+ * Most popovers we'll speculatively place and render per second as the
+ * pointer wanders over the panel. Anything beyond that is dropped, as it's
+ * unlikely to be clicked anyway.
+ */
+#define SPECULATE_RATE 10
+
+/**
+ * Used for tracking each registered parent widget and its popover
+ */
+typedef struct BudgiePopoverEntry {
+        GtkWidget *parent_widget;
+        BudgiePopover *popover;
+        gboolean shared;    /* Shown in the manager's shared popover */
+        GtkWidget *content; /* Shared content, NULL until built for factory entries */
+        BudgiePopoverContentFunc factory;
+        gpointer factory_data;
+        GDestroyNotify factory_notify;
+        gint64 hidden_since; /* Monotonic time that the content was last hidden */
+        GdkRectangle geometry; /* Absolute screen geometry at the last index build */
+        gboolean indexed;
+        guint64 last_used; /* LRU stamp for the warm pool */
+        GQueue *lru_queue; /* Warm or cold queue holding us, NULL for shared entries */
+        GList *lru_link;
+} BudgiePopoverEntry;
+
 struct _BudgiePopoverManagerClass {
         GObjectClass parent_class;
 };
@@ -25,7 +80,47 @@ struct _BudgiePopoverManagerClass {
 struct _BudgiePopoverManager {
         GObject parent;
         GHashTable *popovers;
+        GHashTable *popover_entries; /* Popover to entry, for entries with their own popover */
+        GHashTable *index;
+        gboolean index_dirty;
+        guint index_serial;
+        gint index_x1, index_y1, index_x2, index_y2; /* Cells covered by the index */
         BudgiePopover *active_popover;
+        guint warm_source;
+        guint warm_budget;
+        guint64 use_serial;
+        GQueue warm; /* Realized entries, most recently used first */
+        GQueue cold; /* Unrealized entries, most recently used first */
+        BudgiePopover *warming;      /* Popover currently being prepared by us */
+        BudgiePopover *cold_popover; /* Popover that had to realize for its own show */
+        BudgiePopover *shared_popover; /* Single window hosting all registered content */
+        guint n_shared;                /* Entries showing their content in it */
+        GtkWidget *shared_widget;      /* Parent widget the shared popover is showing for */
+        guint content_timeout;
+        guint content_source;
+        GdkSeat *grab_seat;           /* Seat grabbed for the current menu session */
+        GdkWindow *grab_window;       /* Window currently holding that grab */
+        BudgiePopover *pending_hide;  /* Old popover to hide once the new one has the grab */
+        BudgiePopover *switch_target; /* Popover to show on the next frame clock update */
+        GdkFrameClock *switch_clock;
+        gulong switch_id;
+        gint64 switch_start; /* Time that the roll-over was triggered */
+        GdkFrameClock *paint_clock;
+        gulong paint_id;
+        guint show_source;         /* Single pending show, newer requests replace it */
+        BudgiePopover *show_target;
+        gint64 show_requested; /* Time of the latest request, pending or switching */
+        BudgieStats stats;
+        gchar *stats_path; /* Where to dump the statistics as JSON, if anywhere */
+        guint stats_source;
+        BudgiePopover *router; /* Only popover we listen to for crossing events */
+        gulong router_id;
+        GHashTable *toplevels; /* Toplevels we watch pointer motion and style on */
+        GdkScreen *screen;     /* Screen we follow the compositor on for our popovers */
+        GtkWidget *hover_widget; /* Registered widget the pointer was last over */
+        guint speculate_source;
+        gint64 speculate_window; /* Start of the current rate limiting second */
+        guint speculate_count;
 };
 
 G_DEFINE_TYPE(BudgiePopoverManager, budgie_popover_manager, G_TYPE_OBJECT)
@@ -36,14 +131,42 @@ static void budgie_popover_manager_link_signals(BudgiePopoverManager *manager,
                                                 GtkWidget *parent_widget, BudgiePopover *popover);
 static void budgie_popover_manager_unlink_signals(BudgiePopoverManager *manager,
                                                   GtkWidget *parent_widget, BudgiePopover *popover);
-static gboolean budgie_popover_manager_coords_within_window(GtkWindow *window, gint root_x,
-                                                            gint root_y);
-static BudgiePopover *budgie_popover_manager_get_popover_for_coords(BudgiePopoverManager *self,
-                                                                    gint root_x, gint root_y);
-static gboolean budgie_popover_manager_popover_mapped(BudgiePopover *popover, GdkEvent *event,
-                                                      BudgiePopoverManager *self);
-static gboolean budgie_popover_manager_popover_unmapped(BudgiePopover *popover, GdkEvent *event,
-                                                        BudgiePopoverManager *self);
+static BudgiePopoverEntry *budgie_popover_manager_get_entry_for_coords(BudgiePopoverManager *self,
+                                                                       gint root_x, gint root_y);
+static void budgie_popover_manager_invalidate_index(BudgiePopoverManager *self);
+static void budgie_popover_manager_rebuild_index(BudgiePopoverManager *self);
+static void budgie_popover_manager_queue_warm(BudgiePopoverManager *self);
+static void budgie_popover_manager_show_entry(BudgiePopoverManager *self,
+                                              BudgiePopoverEntry *entry);
+static void budgie_popover_entry_free(BudgiePopoverEntry *entry);
+static void budgie_popover_manager_content_hidden(BudgiePopoverManager *self,
+                                                  GtkWidget *parent_widget);
+static void budgie_popover_manager_switch_entry(BudgiePopoverManager *self,
+                                                BudgiePopoverEntry *entry);
+static void budgie_popover_manager_cancel_switch(BudgiePopoverManager *self);
+static void budgie_popover_manager_grab_session(BudgiePopoverManager *self,
+                                                BudgiePopover *popover);
+static void budgie_popover_manager_unwatch_paint(BudgiePopoverManager *self);
+static void budgie_popover_manager_queue_show(BudgiePopoverManager *self, BudgiePopover *popover);
+static void budgie_popover_manager_cancel_show(BudgiePopoverManager *self, BudgiePopover *popover);
+static gboolean budgie_popover_manager_stats_signalled(gpointer v);
+static void budgie_popover_manager_forget_popover(BudgiePopoverManager *self,
+                                                  BudgiePopover *popover);
+static void budgie_popover_manager_route_events(BudgiePopoverManager *self,
+                                                BudgiePopover *popover);
+static void budgie_popover_manager_unlink_entry(BudgiePopoverManager *self,
+                                                BudgiePopoverEntry *entry);
+static void budgie_popover_manager_ungrab_session(BudgiePopoverManager *self);
+static void budgie_popover_manager_watch_widget(BudgiePopoverManager *self,
+                                                GtkWidget *parent_widget);
+static gboolean budgie_popover_manager_motion_notify(BudgiePopoverManager *self,
+                                                     GdkEventMotion *motion,
+                                                     GtkWidget *toplevel);
+static void budgie_popover_manager_touch(BudgiePopoverManager *self, BudgiePopoverEntry *entry);
+static void budgie_popover_manager_composited_changed(BudgiePopoverManager *self);
+static void budgie_popover_manager_lru_move(BudgiePopoverEntry *entry, GQueue *queue);
+static gboolean budgie_popover_manager_make_room(BudgiePopoverManager *self,
+                                                 BudgiePopoverEntry *target);
 
 /**
  * budgie_popover_manager_new:
@@ -63,9 +186,63 @@ BudgiePopoverManager *budgie_popover_manager_new()
 static void budgie_popover_manager_dispose(GObject *obj)
 {
         BudgiePopoverManager *self = NULL;
+        GHashTableIter iter = { 0 };
+        BudgiePopoverEntry *entry = NULL;
+        GtkWidget *toplevel = NULL;
 
         self = BUDGIE_POPOVER_MANAGER(obj);
+        budgie_popover_manager_route_events(self, NULL);
+        budgie_popover_manager_cancel_switch(self);
+        budgie_popover_manager_cancel_show(self, NULL);
+        budgie_popover_manager_unwatch_paint(self);
+        if (self->warm_source > 0) {
+                g_source_remove(self->warm_source);
+                self->warm_source = 0;
+        }
+        if (self->content_source > 0) {
+                g_source_remove(self->content_source);
+                self->content_source = 0;
+        }
+        if (self->speculate_source > 0) {
+                g_source_remove(self->speculate_source);
+                self->speculate_source = 0;
+        }
+        if (self->stats_source > 0) {
+                g_source_remove(self->stats_source);
+                self->stats_source = 0;
+        }
+        if (self->stats_path) {
+                budgie_popover_manager_dump_stats(self, self->stats_path);
+                g_clear_pointer(&self->stats_path, g_free);
+        }
+        /* Popovers may well outlive us, so they must stop calling us */
+        if (self->popovers) {
+                g_hash_table_iter_init(&iter, self->popovers);
+                while (g_hash_table_iter_next(&iter, NULL, (void **)&entry)) {
+                        budgie_popover_manager_unlink_entry(self, entry);
+                        g_hash_table_iter_remove(&iter);
+                }
+        }
+        if (self->toplevels) {
+                g_hash_table_iter_init(&iter, self->toplevels);
+                while (g_hash_table_iter_next(&iter, (void **)&toplevel, NULL)) {
+                        g_signal_handlers_disconnect_by_data(toplevel, self);
+                }
+        }
+        g_clear_pointer(&self->toplevels, g_hash_table_unref);
+        if (self->screen) {
+                g_signal_handlers_disconnect_by_data(self->screen, self);
+                self->screen = NULL;
+        }
+        g_clear_pointer(&self->index, g_hash_table_unref);
         g_clear_pointer(&self->popovers, g_hash_table_unref);
+        g_clear_pointer(&self->popover_entries, g_hash_table_unref);
+        if (self->shared_popover) {
+                budgie_popover_set_manager(self->shared_popover, NULL);
+                gtk_widget_destroy(GTK_WIDGET(self->shared_popover));
+                self->shared_popover = NULL;
+                self->shared_widget = NULL;
+        }
 
         G_OBJECT_CLASS(budgie_popover_manager_parent_class)->dispose(obj);
 }
@@ -93,12 +270,46 @@ static void budgie_popover_manager_init(BudgiePopoverManager *self)
         /* We don't re-ref anything as we just effectively hold floating references
          * to the WhateverTheyAres
          */
-        self->popovers = g_hash_table_new_full(g_direct_hash, g_direct_equal, NULL, NULL);
+        self->popovers = g_hash_table_new_full(g_direct_hash,
+                                               g_direct_equal,
+                                               NULL,
+                                               (GDestroyNotify)budgie_popover_entry_free);
+        self->popover_entries = g_hash_table_new(g_direct_hash, g_direct_equal);
+
+        /* Cell key to a GPtrArray of the entries overlapping that cell */
+        self->index = g_hash_table_new_full(g_direct_hash,
+                                            g_direct_equal,
+                                            NULL,
+                                            (GDestroyNotify)g_ptr_array_unref);
+        self->index_dirty = TRUE;
+        g_queue_init(&self->warm);
+        g_queue_init(&self->cold);
+        self->toplevels = g_hash_table_new(g_direct_hash, g_direct_equal);
+        self->warm_budget = WARM_BUDGET_DEFAULT;
+
+        /* One handler for the compositor coming and going, not one per popover */
+        self->screen = gdk_screen_get_default();
+        if (self->screen) {
+                g_signal_connect_swapped(self->screen,
+                                         "composited-changed",
+                                         G_CALLBACK(budgie_popover_manager_composited_changed),
+                                         self);
+        }
+        self->content_timeout = CONTENT_TIMEOUT_DEFAULT;
+
+        /* Statistics are always gathered, but only dumped on request */
+        self->stats_path = g_strdup(g_getenv("BUDGIE_POPOVER_STATS"));
+        if (self->stats_path) {
+                self->stats_source =
+                    g_unix_signal_add(SIGUSR1, budgie_popover_manager_stats_signalled, self);
+        }
 }
 
 void budgie_popover_manager_register_popover(BudgiePopoverManager *self, GtkWidget *parent_widget,
                                              BudgiePopover *popover)
 {
+        BudgiePopoverEntry *entry = NULL;
+
         g_assert(self != NULL);
         g_return_if_fail(parent_widget != NULL && popover != NULL);
 
@@ -111,222 +322,1654 @@ void budgie_popover_manager_register_popover(BudgiePopoverManager *self, GtkWidg
         /* We're a popover manager, so we're meant for use in some kind of panel
          * situation. Use toplevel hints for better positioning */
         budgie_popover_set_position_policy(popover, BUDGIE_POPOVER_POSITION_TOPLEVEL_HINT);
+        budgie_popover_set_managed_grab(popover, TRUE);
+
+        entry = g_new0(BudgiePopoverEntry, 1);
+        entry->parent_widget = parent_widget;
+        entry->popover = popover;
 
         /* Stick it into the map and hook it up */
+        budgie_geometry_cache_track(parent_widget);
         budgie_popover_manager_link_signals(self, parent_widget, popover);
-        g_hash_table_insert(self->popovers, parent_widget, popover);
+        g_hash_table_insert(self->popovers, parent_widget, entry);
+        g_hash_table_insert(self->popover_entries, popover, entry);
+        budgie_popover_manager_lru_move(entry,
+                                        gtk_widget_get_realized(GTK_WIDGET(popover)) ? &self->warm
+                                                                                     : &self->cold);
+        budgie_popover_manager_invalidate_index(self);
+        budgie_popover_manager_queue_warm(self);
 }
 
-void budgie_popover_manager_unregister_popover(BudgiePopoverManager *self, GtkWidget *parent_widget)
+/**
+ * Create the popover window shared by all registered content on first use
+ */
+static BudgiePopover *budgie_popover_manager_get_shared_popover(BudgiePopoverManager *self)
+{
+        if (self->shared_popover) {
+                return self->shared_popover;
+        }
+
+        /* relative-to is only set when showing, and cleared again before the
+         * widget goes away, so that the popover doesn't destroy itself too */
+        self->shared_popover = BUDGIE_POPOVER(budgie_popover_new(NULL));
+        budgie_popover_set_position_policy(self->shared_popover,
+                                           BUDGIE_POPOVER_POSITION_TOPLEVEL_HINT);
+        budgie_popover_set_managed_grab(self->shared_popover, TRUE);
+        budgie_popover_manager_link_signals(self, NULL, self->shared_popover);
+        return self->shared_popover;
+}
+
+/**
+ * Take whatever content is in the shared popover back out of it
+ */
+static void budgie_popover_manager_take_content(BudgiePopoverManager *self)
+{
+        GtkWidget *content = NULL;
+
+        content = gtk_bin_get_child(GTK_BIN(self->shared_popover));
+        content = content ? gtk_bin_get_child(GTK_BIN(content)) : NULL;
+        if (content) {
+                gtk_container_remove(GTK_CONTAINER(gtk_widget_get_parent(content)), content);
+        }
+}
+
+/**
+ * Common registration for entries sharing the manager's popover, with
+ * @caller naming the public API for any warnings
+ */
+static BudgiePopoverEntry *budgie_popover_manager_register_shared(BudgiePopoverManager *self,
+                                                                  GtkWidget *parent_widget,
+                                                                  const gchar *caller)
+{
+        BudgiePopoverEntry *entry = NULL;
+
+        if (g_hash_table_contains(self->popovers, parent_widget)) {
+                g_warning("%s(): Widget %p is already registered",
+                          caller,
+                          (gpointer)parent_widget);
+                return NULL;
+        }
+
+        entry = g_new0(BudgiePopoverEntry, 1);
+        entry->parent_widget = parent_widget;
+        entry->shared = TRUE;
+
+        /* Pinned from now on, for as long as anything is registered in it */
+        budgie_popover_manager_get_shared_popover(self);
+        budgie_geometry_cache_track(parent_widget);
+        budgie_popover_manager_link_signals(self, parent_widget, NULL);
+        g_hash_table_insert(self->popovers, parent_widget, entry);
+        self->n_shared++;
+        budgie_popover_manager_invalidate_index(self);
+        budgie_popover_manager_queue_warm(self);
+
+        return entry;
+}
+
+/**
+ * budgie_popover_manager_register_content:
+ * @parent_widget: Widget that the content relates to
+ * @content: Widget to display in the shared popover for @parent_widget
+ *
+ * Register @content to be shown in a single popover window shared by every
+ * widget registered this way. Showing a different widget's content, or
+ * rolling over to it, swaps the content and moves the existing window rather
+ * than mapping a new one.
+ */
+void budgie_popover_manager_register_content(BudgiePopoverManager *self, GtkWidget *parent_widget,
+                                             GtkWidget *content)
 {
+        BudgiePopoverEntry *entry = NULL;
+
         g_assert(self != NULL);
-        g_return_if_fail(parent_widget != NULL);
-        BudgiePopover *popover = NULL;
+        g_return_if_fail(parent_widget != NULL && content != NULL);
 
-        popover = g_hash_table_lookup(self->popovers, parent_widget);
-        if (!popover) {
-                g_warning("unregister_popover(): Widget %p is unknown", (gpointer)parent_widget);
+        entry = budgie_popover_manager_register_shared(self, parent_widget, "register_content");
+        if (entry) {
+                entry->content = g_object_ref_sink(content);
+        }
+}
+
+/**
+ * budgie_popover_manager_register_factory:
+ * @parent_widget: Widget that the content relates to
+ * @factory: Function to build the content for @parent_widget
+ * @udata: User data for @factory
+ * @notify: (allow-none): Called to free @udata once @parent_widget is unregistered
+ *
+ * Like budgie_popover_manager_register_content(), but the content is only
+ * built the first time it is shown. Once it has been hidden for longer than
+ * the content timeout, it is destroyed again and rebuilt on the next show.
+ */
+void budgie_popover_manager_register_factory(BudgiePopoverManager *self, GtkWidget *parent_widget,
+                                             BudgiePopoverContentFunc factory, gpointer udata,
+                                             GDestroyNotify notify)
+{
+        BudgiePopoverEntry *entry = NULL;
+
+        g_assert(self != NULL);
+        g_return_if_fail(parent_widget != NULL && factory != NULL);
+
+        entry = budgie_popover_manager_register_shared(self, parent_widget, "register_factory");
+        if (!entry) {
+                if (notify) {
+                        notify(udata);
+                }
                 return;
         }
 
-        budgie_popover_manager_unlink_signals(self, parent_widget, popover);
-        g_hash_table_remove(self->popovers, parent_widget);
+        entry->factory = factory;
+        entry->factory_data = udata;
+        entry->factory_notify = notify;
 }
 
 /**
- * Show a popover on the idle loop to prevent any weird event locks
+ * Drop the content for @entry, destroying it if we built it ourselves
  */
-static gboolean show_one_popover(gpointer v)
+static void budgie_popover_entry_release_content(BudgiePopoverEntry *entry)
 {
-        gtk_widget_show(GTK_WIDGET(v));
-        return FALSE;
+        GtkWidget *parent = NULL;
+
+        if (!entry->content) {
+                return;
+        }
+
+        parent = gtk_widget_get_parent(entry->content);
+        if (parent) {
+                gtk_container_remove(GTK_CONTAINER(parent), entry->content);
+        }
+        if (entry->factory) {
+                gtk_widget_destroy(entry->content);
+        }
+        g_clear_object(&entry->content);
 }
 
-void budgie_popover_manager_show_popover(BudgiePopoverManager *self, GtkWidget *parent_widget)
+/**
+ * Free an entry, taking its content out of the shared popover if need be
+ */
+static void budgie_popover_entry_free(BudgiePopoverEntry *entry)
 {
-        BudgiePopover *popover = NULL;
+        budgie_popover_entry_release_content(entry);
+        if (entry->factory_notify) {
+                entry->factory_notify(entry->factory_data);
+        }
+        g_free(entry);
+}
+
+/**
+ * Stop the shared popover from showing for @parent_widget, as it is going
+ * away. The popover destroys itself along with its relative-to widget, so
+ * that is checked directly rather than trusting that we heard first.
+ */
+static void budgie_popover_manager_release_shared(BudgiePopoverManager *self,
+                                                  GtkWidget *parent_widget)
+{
+        GtkWidget *relative_to = NULL;
+
+        if (self->shared_widget == parent_widget) {
+                self->shared_widget = NULL;
+        }
+        if (!self->shared_popover) {
+                return;
+        }
+
+        g_object_get(self->shared_popover, "relative-to", &relative_to, NULL);
+        if (relative_to == parent_widget) {
+                gtk_widget_hide(GTK_WIDGET(self->shared_popover));
+                g_object_set(self->shared_popover, "relative-to", NULL, NULL);
+        }
+        g_clear_object(&relative_to);
+}
+
+/**
+ * Disconnect everything linking @entry to us, without removing it from our
+ * tables. Nothing here depends on how many other entries there are.
+ */
+static void budgie_popover_manager_unlink_entry(BudgiePopoverManager *self,
+                                                BudgiePopoverEntry *entry)
+{
+        GtkWidget *parent_widget = entry->parent_widget;
+
+        if (self->hover_widget == parent_widget) {
+                self->hover_widget = NULL;
+        }
+        if (entry->shared) {
+                budgie_popover_manager_release_shared(self, parent_widget);
+                budgie_popover_manager_unlink_signals(self, parent_widget, NULL);
+                self->n_shared--;
 
+                /* Nobody left to use the shared window, so give back its slot */
+                if (self->n_shared == 0 && self->shared_popover &&
+                    gtk_widget_get_realized(GTK_WIDGET(self->shared_popover)) &&
+                    !gtk_widget_get_visible(GTK_WIDGET(self->shared_popover))) {
+                        gtk_widget_unrealize(GTK_WIDGET(self->shared_popover));
+                }
+        } else {
+                budgie_popover_manager_unlink_signals(self, parent_widget, entry->popover);
+                budgie_popover_set_managed_grab(entry->popover, FALSE);
+                budgie_popover_manager_forget_popover(self, entry->popover);
+                budgie_popover_manager_lru_move(entry, NULL);
+                g_hash_table_remove(self->popover_entries, entry->popover);
+        }
+        budgie_geometry_cache_untrack(parent_widget);
+}
+
+/**
+ * Unlink and free @entry
+ */
+static void budgie_popover_manager_remove_entry(BudgiePopoverManager *self,
+                                                BudgiePopoverEntry *entry)
+{
+        budgie_popover_manager_unlink_entry(self, entry);
+        g_hash_table_remove(self->popovers, entry->parent_widget);
+        budgie_popover_manager_invalidate_index(self);
+}
+
+void budgie_popover_manager_unregister_popover(BudgiePopoverManager *self, GtkWidget *parent_widget)
+{
         g_assert(self != NULL);
         g_return_if_fail(parent_widget != NULL);
+        BudgiePopoverEntry *entry = NULL;
 
-        popover = g_hash_table_lookup(self->popovers, parent_widget);
-        if (!popover) {
-                g_warning("show_popover(): Widget %p is unknown", (gpointer)parent_widget);
+        entry = g_hash_table_lookup(self->popovers, parent_widget);
+        if (!entry) {
+                g_warning("unregister_popover(): Widget %p is unknown", (gpointer)parent_widget);
                 return;
         }
 
-        g_idle_add(show_one_popover, popover);
+        budgie_popover_manager_remove_entry(self, entry);
 }
 
 /**
- * The widget has died, so remove it from our internal state
+ * Show the pending popover, if it is still wanted
  */
-static void budgie_popover_manager_widget_died(BudgiePopoverManager *self, GtkWidget *child)
+static gboolean budgie_popover_manager_show_pending(gpointer v)
 {
-        if (!g_hash_table_contains(self->popovers, child)) {
+        BudgiePopoverManager *self = v;
+        BudgiePopover *popover = self->show_target;
+
+        self->show_source = 0;
+        self->show_target = NULL;
+        budgie_stats_count(&self->stats, BUDGIE_STATS_SHOW_DISPATCHES);
+
+        if (popover) {
+                budgie_popover_set_show_start(popover, self->show_requested);
+                gtk_widget_show(GTK_WIDGET(popover));
+        }
+        return G_SOURCE_REMOVE;
+}
+
+/**
+ * Show a popover on the idle loop to prevent any weird event locks. There is
+ * only ever one pending show, so a newer request simply replaces the target
+ * of an older one.
+ */
+static void budgie_popover_manager_queue_show(BudgiePopoverManager *self, BudgiePopover *popover)
+{
+        /* Can't have a frame switch racing us */
+        budgie_popover_manager_cancel_switch(self);
+
+        budgie_stats_count(&self->stats, BUDGIE_STATS_SHOW_REQUESTS);
+        self->show_requested = g_get_monotonic_time();
+        self->show_target = popover;
+        if (self->show_source > 0) {
                 return;
         }
-        g_hash_table_remove(self->popovers, child);
+        self->show_source =
+            g_idle_add_full(SHOW_PRIORITY, budgie_popover_manager_show_pending, self, NULL);
 }
 
 /**
- * Hook up the various signals we need to manage this popover correctly
+ * Cancel the pending show if it targets @popover, or any pending show when
+ * @popover is NULL
  */
-static void budgie_popover_manager_link_signals(BudgiePopoverManager *self,
-                                                GtkWidget *parent_widget, BudgiePopover *popover)
+static void budgie_popover_manager_cancel_show(BudgiePopoverManager *self, BudgiePopover *popover)
 {
-        /* Need enter-notify to check if we entered a parent widget */
-        g_signal_connect_swapped(popover,
-                                 "enter-notify-event",
-                                 G_CALLBACK(budgie_popover_manager_enter_notify),
-                                 self);
-        g_signal_connect_swapped(parent_widget,
-                                 "destroy",
-                                 G_CALLBACK(budgie_popover_manager_widget_died),
-                                 self);
-        g_signal_connect(popover,
-                         "map-event",
-                         G_CALLBACK(budgie_popover_manager_popover_mapped),
-                         self);
-        g_signal_connect(popover,
-                         "unmap-event",
-                         G_CALLBACK(budgie_popover_manager_popover_unmapped),
-                         self);
+        if (self->show_source == 0 || (popover && popover != self->show_target)) {
+                return;
+        }
+        g_source_remove(self->show_source);
+        self->show_source = 0;
+        self->show_target = NULL;
 }
 
 /**
- * Disconnect any prior signals for this popover so we stop receiving events for it
+ * Drop every pending operation and reference to @popover
  */
-static void budgie_popover_manager_unlink_signals(BudgiePopoverManager *self,
-                                                  GtkWidget *parent_widget, BudgiePopover *popover)
+static void budgie_popover_manager_forget_popover(BudgiePopoverManager *self,
+                                                  BudgiePopover *popover)
 {
-        g_signal_handlers_disconnect_by_data(parent_widget, self);
-        g_signal_handlers_disconnect_by_data(popover, self);
+        budgie_popover_manager_cancel_show(self, popover);
+        if (self->switch_target == popover) {
+                budgie_popover_manager_cancel_switch(self);
+        }
+        if (self->pending_hide == popover) {
+                self->pending_hide = NULL;
+        }
+        if (self->active_popover == popover) {
+                self->active_popover = NULL;
+        }
+        if (self->warming == popover) {
+                self->warming = NULL;
+        }
+        if (self->cold_popover == popover) {
+                self->cold_popover = NULL;
+        }
+        if (self->router == popover) {
+                budgie_popover_manager_route_events(self, NULL);
+        }
+        if (self->grab_window && self->grab_window == gtk_widget_get_window(GTK_WIDGET(popover))) {
+                budgie_popover_manager_ungrab_session(self);
+        }
 }
 
 /**
- * Handle an enter-notify for a widget to handle roll-over selection when grabbed
+ * A popover was destroyed behind our back, i.e. along with its relative-to
+ * widget, so drop its entry before anything can reference it again
  */
-static gboolean budgie_popover_manager_enter_notify(BudgiePopoverManager *self,
-                                                    GdkEventCrossing *crossing, GtkWidget *widget)
+void budgie_popover_manager_popover_died(BudgiePopoverManager *self, BudgiePopover *popover)
 {
-        BudgiePopover *target_popover = NULL;
+        BudgiePopoverEntry *entry = NULL;
 
-        /* We only want to hear about the grabbed events */
-        if (!GTK_IS_WINDOW(widget)) {
-                return GDK_EVENT_PROPAGATE;
+        /* Keep the content alive, and build a new window on the next show */
+        if (popover == self->shared_popover) {
+                budgie_popover_manager_forget_popover(self, popover);
+                budgie_popover_manager_take_content(self);
+                budgie_popover_set_manager(popover, NULL);
+                self->shared_popover = NULL;
+                self->shared_widget = NULL;
+                return;
         }
 
-        /* If we're inside the popover, not interested. */
-        if (budgie_popover_manager_coords_within_window(GTK_WINDOW(widget),
-                                                        (gint)crossing->x_root,
-                                                        (gint)crossing->y_root)) {
-                return GDK_EVENT_PROPAGATE;
+        entry = g_hash_table_lookup(self->popover_entries, popover);
+        if (entry) {
+                budgie_popover_manager_remove_entry(self, entry);
+        } else {
+                budgie_popover_manager_forget_popover(self, popover);
         }
+}
 
-        target_popover = budgie_popover_manager_get_popover_for_coords(self,
-                                                                       (gint)crossing->x_root,
-                                                                       (gint)crossing->y_root);
-        if (!target_popover) {
-                return GDK_EVENT_PROPAGATE;
+void budgie_popover_manager_show_popover(BudgiePopoverManager *self, GtkWidget *parent_widget)
+{
+        BudgiePopoverEntry *entry = NULL;
+
+        g_assert(self != NULL);
+        g_return_if_fail(parent_widget != NULL);
+
+        entry = g_hash_table_lookup(self->popovers, parent_widget);
+        if (!entry) {
+                g_warning("show_popover(): Widget %p is unknown", (gpointer)parent_widget);
+                return;
         }
 
-        /* Don't show the same popover again. :P */
-        if (target_popover == self->active_popover) {
-                return GDK_EVENT_PROPAGATE;
+        budgie_popover_manager_show_entry(self, entry);
+}
+
+/**
+ * Get the popover for @entry ready to be shown. Shared content is swapped
+ * into the shared popover, which is then repositioned by its next
+ * size_allocate if it was already visible.
+ *
+ * Returns: The popover to show, or NULL if there is nothing to show
+ */
+static BudgiePopover *budgie_popover_manager_prepare_entry(BudgiePopoverManager *self,
+                                                           BudgiePopoverEntry *entry)
+{
+        BudgiePopover *shared = NULL;
+
+        if (!entry->shared) {
+                return entry->popover;
         }
 
-        if (self->active_popover) {
-                gtk_widget_hide(GTK_WIDGET(self->active_popover));
-                self->active_popover = NULL;
+        /* Build the content on first use, or after it was released */
+        if (!entry->content) {
+                entry->content = entry->factory(entry->parent_widget, entry->factory_data);
+                if (!entry->content) {
+                        g_warning("show_popover(): No content for widget %p",
+                                  (gpointer)entry->parent_widget);
+                        return NULL;
+                }
+                g_object_ref_sink(entry->content);
         }
 
-        g_idle_add(show_one_popover, target_popover);
+        shared = budgie_popover_manager_get_shared_popover(self);
+        if (self->shared_widget != entry->parent_widget) {
+                if (self->shared_widget) {
+                        budgie_popover_manager_content_hidden(self, self->shared_widget);
+                }
+                budgie_popover_manager_take_content(self);
 
-        return GDK_EVENT_STOP;
+                g_object_set(shared, "relative-to", entry->parent_widget, NULL);
+                gtk_container_add(GTK_CONTAINER(shared), entry->content);
+                gtk_widget_show(entry->content);
+                self->shared_widget = entry->parent_widget;
+
+                /* Allow the window to shrink to the new content */
+                gtk_window_resize(GTK_WINDOW(shared), 1, 1);
+        }
+
+        return shared;
 }
 
 /**
- * Window specific method that determines if X,Y is currently within the
- * confines of the GtkWindow. This helps us quickly determine that we've
- * re-entered a BudgiePopover and don't need to find an associated window.
+ * Show the popover for @entry on the idle loop
  */
-static gboolean budgie_popover_manager_coords_within_window(GtkWindow *window, gint root_x,
-                                                            gint root_y)
+static void budgie_popover_manager_show_entry(BudgiePopoverManager *self,
+                                              BudgiePopoverEntry *entry)
 {
-        gint x, y = 0;
-        gint w, h = 0;
-        gtk_window_get_position(window, &x, &y);
-        gtk_window_get_size(window, &w, &h);
+        BudgiePopover *popover = NULL;
 
-        if ((root_x >= x && root_x <= x + w) && (root_y >= y && root_y <= y + h)) {
-                return TRUE;
+        popover = budgie_popover_manager_prepare_entry(self, entry);
+        if (popover && !gtk_widget_get_visible(GTK_WIDGET(popover))) {
+                budgie_popover_manager_queue_show(self, popover);
         }
-        return FALSE;
 }
 
 /**
- * After having received an enter notify event and determining that it isn't
- * a BudgiePopover that we entered, we iterate our registered widgets and try
- * to find the one matching the X, Y coordinates.
- *
- * Upon finding a matching widget, we'll return the associated popover.
+ * Stop watching for the first frame of a switched-to popover
  */
-static BudgiePopover *budgie_popover_manager_get_popover_for_coords(BudgiePopoverManager *self,
-                                                                    gint root_x, gint root_y)
+static void budgie_popover_manager_unwatch_paint(BudgiePopoverManager *self)
 {
-        GHashTableIter iter = { 0 };
-        GtkWidget *parent_widget = NULL;
-        BudgiePopover *assoc_popover = NULL;
+        if (!self->paint_clock) {
+                return;
+        }
+        g_signal_handler_disconnect(self->paint_clock, self->paint_id);
+        g_clear_object(&self->paint_clock);
+        self->paint_id = 0;
+}
 
-        g_hash_table_iter_init(&iter, self->popovers);
-        while (g_hash_table_iter_next(&iter, (void **)&parent_widget, (void **)&assoc_popover)) {
-                GtkAllocation alloc = { 0 };
-                GtkWidget *toplevel = NULL;
-                GdkWindow *toplevel_window = NULL;
-                gint rx, ry = 0;
-                gint x, y = 0;
-
-                /* Determine the parent_widget's absolute x, y on screen */
-                toplevel = gtk_widget_get_toplevel(parent_widget);
-                toplevel_window = gtk_widget_get_window(toplevel);
-                gdk_window_get_position(toplevel_window, &x, &y);
-                gtk_widget_translate_coordinates(parent_widget, toplevel, x, y, &rx, &ry);
-                gtk_widget_get_allocation(parent_widget, &alloc);
-
-                if ((root_x >= rx && root_x <= rx + alloc.width) &&
-                    (root_y >= ry && root_y <= ry + alloc.height)) {
-                        return assoc_popover;
-                }
+/**
+ * First frame of the new popover is out, so the roll-over is complete
+ */
+static void budgie_popover_manager_switch_painted(__budgie_unused__ GdkFrameClock *clock,
+                                                  BudgiePopoverManager *self)
+{
+        budgie_stats_record(&self->stats,
+                            BUDGIE_STATS_ROLLOVER,
+                            g_get_monotonic_time() - self->switch_start);
+        budgie_popover_manager_unwatch_paint(self);
+}
+
+/**
+ * Abandon any switch that hasn't been committed yet
+ */
+static void budgie_popover_manager_cancel_switch(BudgiePopoverManager *self)
+{
+        if (!self->switch_clock) {
+                return;
         }
+        g_signal_handler_disconnect(self->switch_clock, self->switch_id);
+        g_clear_object(&self->switch_clock);
+        self->switch_id = 0;
+        self->switch_target = NULL;
+}
 
-        return NULL;
+/**
+ * Commit the switch within a single frame clock update: show the incoming
+ * popover, hand it the grab and hide the outgoing popover, so that there is
+ * never a frame without a popover on screen.
+ */
+static void budgie_popover_manager_commit_switch(__budgie_unused__ GdkFrameClock *clock,
+                                                 BudgiePopoverManager *self)
+{
+        BudgiePopover *incoming = self->switch_target;
+        BudgiePopover *outgoing = self->pending_hide;
+        GdkFrameClock *paint_clock = NULL;
+
+        budgie_popover_manager_cancel_switch(self);
+        self->pending_hide = NULL;
+        budgie_stats_count(&self->stats, BUDGIE_STATS_SHOW_DISPATCHES);
+
+        budgie_popover_set_show_start(incoming, self->show_requested);
+        gtk_widget_show(GTK_WIDGET(incoming));
+        self->active_popover = incoming;
+        budgie_popover_manager_grab_session(self, incoming);
+
+        if (outgoing && outgoing != incoming) {
+                gtk_widget_hide(GTK_WIDGET(outgoing));
+        }
+
+        /* Measure up to the first frame of the new popover */
+        budgie_popover_manager_unwatch_paint(self);
+        paint_clock = gtk_widget_get_frame_clock(GTK_WIDGET(incoming));
+        if (paint_clock) {
+                self->paint_clock = g_object_ref(paint_clock);
+                self->paint_id = g_signal_connect(paint_clock,
+                                                  "after-paint",
+                                                  G_CALLBACK(budgie_popover_manager_switch_painted),
+                                                  self);
+        }
 }
 
 /**
- * Handle the BudgiePopover becoming visible on screen, updating our knowledge
- * of who the currently active popover is
+ * Roll over from the active popover to the one for @entry. The incoming
+ * popover is prepared right away, and the switch is then committed on the
+ * next frame clock update of the outgoing popover.
  */
-static gboolean budgie_popover_manager_popover_mapped(BudgiePopover *popover,
-                                                      __budgie_unused__ GdkEvent *event,
-                                                      BudgiePopoverManager *self)
+static void budgie_popover_manager_switch_entry(BudgiePopoverManager *self,
+                                                BudgiePopoverEntry *entry)
 {
-        self->active_popover = popover;
-        return GDK_EVENT_PROPAGATE;
+        BudgiePopover *incoming = NULL;
+        GdkFrameClock *clock = NULL;
+
+        incoming = budgie_popover_manager_prepare_entry(self, entry);
+        if (!incoming) {
+                return;
+        }
+
+        /* Shared popover, already up, and now just moving */
+        if (incoming == self->active_popover) {
+                self->pending_hide = NULL;
+                return;
+        }
+
+        budgie_popover_prepare(incoming);
+
+        clock = self->pending_hide ? gtk_widget_get_frame_clock(GTK_WIDGET(self->pending_hide))
+                                   : NULL;
+        if (!clock) {
+                budgie_popover_manager_queue_show(self, incoming);
+                return;
+        }
+
+        /* Newer requests replace anything still pending */
+        budgie_popover_manager_cancel_show(self, NULL);
+        budgie_popover_manager_cancel_switch(self);
+        budgie_stats_count(&self->stats, BUDGIE_STATS_SHOW_REQUESTS);
+        self->show_requested = g_get_monotonic_time();
+        self->switch_target = incoming;
+        self->switch_clock = g_object_ref(clock);
+        self->switch_id = g_signal_connect(clock,
+                                           "update",
+                                           G_CALLBACK(budgie_popover_manager_commit_switch),
+                                           self);
+        gdk_frame_clock_request_phase(clock, GDK_FRAME_CLOCK_PHASE_UPDATE);
 }
 
 /**
- * Handle the BudgiePopover becoming invisible on screen, updating our knowledge
- * of who the currently active popover is
+ * The widget has died, so remove it from our internal state
  */
-static gboolean budgie_popover_manager_popover_unmapped(BudgiePopover *popover,
-                                                        __budgie_unused__ GdkEvent *event,
-                                                        BudgiePopoverManager *self)
+static void budgie_popover_manager_widget_died(BudgiePopoverManager *self, GtkWidget *child)
 {
-        if (popover == self->active_popover) {
-                self->active_popover = NULL;
+        BudgiePopoverEntry *entry = NULL;
+
+        entry = g_hash_table_lookup(self->popovers, child);
+        if (!entry) {
+                return;
         }
-        return GDK_EVENT_PROPAGATE;
+        budgie_popover_manager_remove_entry(self, entry);
+}
+
+/**
+ * Hook up the parent widget, and have the popover report its map, unmap,
+ * realize, grab-broken and destroy to us from its own class vfuncs. Only
+ * the parent widget costs us a signal handler: a widget can be destroyed
+ * while others still hold references to it, and nothing but its own
+ * "destroy" tells us in time to drop the entry. It only ever fires once, for
+ * that widget alone, so it adds nothing to the dispatch of any other event.
+ */
+static void budgie_popover_manager_link_signals(BudgiePopoverManager *self,
+                                                GtkWidget *parent_widget, BudgiePopover *popover)
+{
+        if (parent_widget) {
+                g_signal_connect_swapped(parent_widget,
+                                         "destroy",
+                                         G_CALLBACK(budgie_popover_manager_widget_died),
+                                         self);
+                budgie_popover_manager_watch_widget(self, parent_widget);
+        }
+
+        /* The shared popover is only hooked up once */
+        if (popover) {
+                budgie_popover_set_manager(popover, self);
+        }
+}
+
+/**
+ * Disconnect any prior signals for this popover so we stop receiving events for it
+ */
+static void budgie_popover_manager_unlink_signals(BudgiePopoverManager *self,
+                                                  GtkWidget *parent_widget, BudgiePopover *popover)
+{
+        g_signal_handlers_disconnect_by_data(parent_widget, self);
+        if (popover) {
+                budgie_popover_set_manager(popover, NULL);
+        }
+}
+
+/**
+ * Only the open popover holds the session grab, so it alone sees the
+ * crossing events that drive roll-over. Move our one enter-notify handler
+ * to it rather than connecting one to every registered popover.
+ */
+static void budgie_popover_manager_route_events(BudgiePopoverManager *self,
+                                                BudgiePopover *popover)
+{
+        if (self->router == popover) {
+                return;
+        }
+        if (self->router_id > 0) {
+                g_signal_handler_disconnect(self->router, self->router_id);
+                self->router_id = 0;
+        }
+
+        self->router = popover;
+        if (!popover) {
+                return;
+        }
+        self->router_id = g_signal_connect_swapped(popover,
+                                                   "enter-notify-event",
+                                                   G_CALLBACK(budgie_popover_manager_enter_notify),
+                                                   self);
+}
+
+/**
+ * Handle an enter-notify for a widget to handle roll-over selection when grabbed
+ */
+static gboolean budgie_popover_manager_enter_notify(BudgiePopoverManager *self,
+                                                    GdkEventCrossing *crossing, GtkWidget *widget)
+{
+        BudgiePopoverEntry *target = NULL;
+        BudgiePopover *popover = NULL;
+
+        /* We only want to hear about the grabbed events */
+        if (!GTK_IS_WINDOW(widget)) {
+                return GDK_EVENT_PROPAGATE;
+        }
+
+        /* If we're inside the popover, not interested. */
+        if (budgie_popover_contains_point(BUDGIE_POPOVER(widget),
+                                          (gint)crossing->x_root,
+                                          (gint)crossing->y_root)) {
+                return GDK_EVENT_PROPAGATE;
+        }
+
+        target = budgie_popover_manager_get_entry_for_coords(self,
+                                                             (gint)crossing->x_root,
+                                                             (gint)crossing->y_root);
+        if (!target) {
+                return GDK_EVENT_PROPAGATE;
+        }
+
+        /* Don't show the same popover again. :P */
+        popover = target->shared ? self->shared_popover : target->popover;
+        if (popover == self->active_popover &&
+            (!target->shared || target->parent_widget == self->shared_widget)) {
+                return GDK_EVENT_PROPAGATE;
+        }
+
+        /* The shared popover stays mapped and just moves to the new widget.
+         * Otherwise keep the old popover up until the new one has taken over
+         * the grab, so that the seat is never released in between. */
+        if (self->active_popover && self->active_popover != popover) {
+                self->pending_hide = self->active_popover;
+        }
+
+        budgie_stats_count(&self->stats, BUDGIE_STATS_ROLLOVERS);
+        self->switch_start = g_get_monotonic_time();
+        budgie_popover_manager_switch_entry(self, target);
+
+        return GDK_EVENT_STOP;
+}
+
+/**
+ * The compositor came or went, so every popover we manage must follow suit
+ */
+static void budgie_popover_manager_composited_changed(BudgiePopoverManager *self)
+{
+        GHashTableIter iter = { 0 };
+        BudgiePopover *popover = NULL;
+
+        g_hash_table_iter_init(&iter, self->popover_entries);
+        while (g_hash_table_iter_next(&iter, (void **)&popover, NULL)) {
+                budgie_popover_composited_changed(popover);
+        }
+        if (self->shared_popover) {
+                budgie_popover_composited_changed(self->shared_popover);
+        }
+}
+
+/**
+ * The toplevel style changed, so any popover on it may need to point
+ * elsewhere. Each popover checks whether that's its own toplevel.
+ */
+static void budgie_popover_manager_toplevel_style_updated(BudgiePopoverManager *self,
+                                                          GtkWidget *toplevel)
+{
+        GHashTableIter iter = { 0 };
+        BudgiePopover *popover = NULL;
+
+        g_hash_table_iter_init(&iter, self->popover_entries);
+        while (g_hash_table_iter_next(&iter, (void **)&popover, NULL)) {
+                budgie_popover_toplevel_style_changed(popover, toplevel);
+        }
+        if (self->shared_popover) {
+                budgie_popover_toplevel_style_changed(self->shared_popover, toplevel);
+        }
+}
+
+/**
+ * The toplevel is going away, so there's nothing left to watch on it
+ */
+static void budgie_popover_manager_toplevel_died(BudgiePopoverManager *self, GtkWidget *toplevel)
+{
+        g_hash_table_remove(self->toplevels, toplevel);
+}
+
+/**
+ * Watch pointer motion over @toplevel to find out which registered widget
+ * the pointer is over, and its style for the popovers placed against it.
+ * Each toplevel is only hooked up once, however many registered widgets it
+ * holds.
+ */
+static void budgie_popover_manager_watch_toplevel(BudgiePopoverManager *self, GtkWidget *toplevel)
+{
+        if (g_hash_table_contains(self->toplevels, toplevel)) {
+                return;
+        }
+        g_hash_table_add(self->toplevels, toplevel);
+
+        gtk_widget_add_events(toplevel, GDK_POINTER_MOTION_MASK);
+        g_signal_connect_swapped(toplevel,
+                                 "motion-notify-event",
+                                 G_CALLBACK(budgie_popover_manager_motion_notify),
+                                 self);
+        g_signal_connect_swapped(toplevel,
+                                 "style-updated",
+                                 G_CALLBACK(budgie_popover_manager_toplevel_style_updated),
+                                 self);
+        g_signal_connect_swapped(toplevel,
+                                 "destroy",
+                                 G_CALLBACK(budgie_popover_manager_toplevel_died),
+                                 self);
+}
+
+/**
+ * A registered widget that wasn't in a toplevel yet has now been added to one
+ */
+static void budgie_popover_manager_hierarchy_changed(BudgiePopoverManager *self,
+                                                     __budgie_unused__ GtkWidget *previous,
+                                                     GtkWidget *parent_widget)
+{
+        GtkWidget *toplevel = gtk_widget_get_toplevel(parent_widget);
+
+        if (!gtk_widget_is_toplevel(toplevel)) {
+                return;
+        }
+        g_signal_handlers_disconnect_matched(parent_widget,
+                                             G_SIGNAL_MATCH_ID | G_SIGNAL_MATCH_DATA,
+                                             g_signal_lookup("hierarchy-changed",
+                                                             GTK_TYPE_WIDGET),
+                                             0,
+                                             NULL,
+                                             NULL,
+                                             self);
+        budgie_popover_manager_watch_toplevel(self, toplevel);
+}
+
+/**
+ * Make sure that the toplevel holding @parent_widget is watched, waiting for
+ * it to be packed into one if need be.
+ */
+static void budgie_popover_manager_watch_widget(BudgiePopoverManager *self,
+                                                GtkWidget *parent_widget)
+{
+        GtkWidget *toplevel = gtk_widget_get_toplevel(parent_widget);
+
+        if (gtk_widget_is_toplevel(toplevel)) {
+                budgie_popover_manager_watch_toplevel(self, toplevel);
+                return;
+        }
+        g_signal_connect_swapped(parent_widget,
+                                 "hierarchy-changed",
+                                 G_CALLBACK(budgie_popover_manager_hierarchy_changed),
+                                 self);
+}
+
+/**
+ * Place and render the popover for the hovered widget, so that clicking it
+ * only has to map the window. Entries in the shared popover are left alone,
+ * as speculating on those would mean swapping out its content.
+ */
+static gboolean budgie_popover_manager_speculate_one(gpointer v)
+{
+        BudgiePopoverManager *self = v;
+        BudgiePopoverEntry *entry = NULL;
+
+        self->speculate_source = 0;
+
+        /* Speculating means realizing, which a disabled warm pool rules out */
+        if (self->active_popover || !self->hover_widget || self->warm_budget == 0) {
+                return G_SOURCE_REMOVE;
+        }
+        entry = g_hash_table_lookup(self->popovers, self->hover_widget);
+        if (!entry || entry->shared) {
+                return G_SOURCE_REMOVE;
+        }
+
+        /* Likeliest to be opened next, so the last one the warm pool evicts */
+        budgie_popover_manager_touch(self, entry);
+        if (!gtk_widget_get_realized(GTK_WIDGET(entry->popover)) &&
+            !budgie_popover_manager_make_room(self, entry)) {
+                return G_SOURCE_REMOVE;
+        }
+
+        self->warming = entry->popover;
+        budgie_popover_speculate(entry->popover);
+        self->warming = NULL;
+
+        return G_SOURCE_REMOVE;
+}
+
+/**
+ * Schedule a speculation for the hovered widget, unless we've already done
+ * our share of them this second. A pending one just picks up the newer
+ * widget when it runs.
+ */
+static void budgie_popover_manager_queue_speculate(BudgiePopoverManager *self)
+{
+        gint64 now = g_get_monotonic_time();
+
+        if (self->speculate_source > 0 || self->warm_budget == 0) {
+                return;
+        }
+
+        if (now - self->speculate_window >= G_USEC_PER_SEC) {
+                self->speculate_window = now;
+                self->speculate_count = 0;
+        }
+        if (self->speculate_count >= SPECULATE_RATE) {
+                budgie_stats_count(&self->stats, BUDGIE_STATS_SPECULATIONS_CAPPED);
+                return;
+        }
+        self->speculate_count++;
+
+        self->speculate_source =
+            g_idle_add_full(G_PRIORITY_LOW, budgie_popover_manager_speculate_one, self, NULL);
+}
+
+/**
+ * Track which registered widget the pointer is over while no popover is
+ * open, speculating on each one that it moves on to.
+ */
+static gboolean budgie_popover_manager_motion_notify(BudgiePopoverManager *self,
+                                                     GdkEventMotion *motion,
+                                                     __budgie_unused__ GtkWidget *toplevel)
+{
+        BudgiePopoverEntry *entry = NULL;
+        GtkWidget *hovered = NULL;
+
+        /* Roll-over has it covered while a popover is open */
+        if (self->active_popover) {
+                return GDK_EVENT_PROPAGATE;
+        }
+
+        entry = budgie_popover_manager_get_entry_for_coords(self,
+                                                            (gint)motion->x_root,
+                                                            (gint)motion->y_root);
+        hovered = entry ? entry->parent_widget : NULL;
+        if (hovered == self->hover_widget) {
+                return GDK_EVENT_PROPAGATE;
+        }
+
+        self->hover_widget = hovered;
+        if (entry && !entry->shared) {
+                budgie_popover_manager_queue_speculate(self);
+        }
+
+        return GDK_EVENT_PROPAGATE;
+}
+
+/**
+ * Floor division so that negative screen coordinates (i.e. a monitor placed
+ * to the left of the primary) still land in the correct cell.
+ */
+static inline gint budgie_popover_manager_cell(gint coord)
+{
+        if (coord >= 0) {
+                return coord / INDEX_CELL_SIZE;
+        }
+        return -((-coord + INDEX_CELL_SIZE - 1) / INDEX_CELL_SIZE);
+}
+
+/**
+ * Pack the cell coordinates into a single hash key. Keys only wrap beyond
+ * 65536 cells in either direction, and a collision there would only cost an
+ * extra rectangle test.
+ */
+static inline gpointer budgie_popover_manager_cell_key(gint cell_x, gint cell_y)
+{
+        return GUINT_TO_POINTER((((guint)cell_x & 0xFFFF) << 16) | ((guint)cell_y & 0xFFFF));
+}
+
+/**
+ * Mark the index as stale so that it's rebuilt on the next lookup
+ */
+static void budgie_popover_manager_invalidate_index(BudgiePopoverManager *self)
+{
+        self->index_dirty = TRUE;
+}
+
+/**
+ * Throw away the old index and insert every registered widget into each of
+ * the cells that its on-screen geometry overlaps.
+ */
+static void budgie_popover_manager_rebuild_index(BudgiePopoverManager *self)
+{
+        GHashTableIter iter = { 0 };
+        BudgiePopoverEntry *entry = NULL;
+
+        g_hash_table_remove_all(self->index);
+        self->index_x1 = self->index_y1 = G_MAXINT;
+        self->index_x2 = self->index_y2 = G_MININT;
+
+        g_hash_table_iter_init(&iter, self->popovers);
+        while (g_hash_table_iter_next(&iter, NULL, (void **)&entry)) {
+                gint cell_x1, cell_y1, cell_x2, cell_y2 = 0;
+
+                /* Mapping doesn't touch the geometry, so that is checked per lookup */
+                entry->indexed = budgie_geometry_cache_get(entry->parent_widget, &entry->geometry);
+                if (!entry->indexed) {
+                        continue;
+                }
+
+                /* Bounds are inclusive, matching the hit test */
+                cell_x1 = budgie_popover_manager_cell(entry->geometry.x);
+                cell_y1 = budgie_popover_manager_cell(entry->geometry.y);
+                cell_x2 = budgie_popover_manager_cell(entry->geometry.x + entry->geometry.width);
+                cell_y2 = budgie_popover_manager_cell(entry->geometry.y + entry->geometry.height);
+                self->index_x1 = MIN(self->index_x1, cell_x1);
+                self->index_y1 = MIN(self->index_y1, cell_y1);
+                self->index_x2 = MAX(self->index_x2, cell_x2);
+                self->index_y2 = MAX(self->index_y2, cell_y2);
+
+                for (gint cx = cell_x1; cx <= cell_x2; cx++) {
+                        for (gint cy = cell_y1; cy <= cell_y2; cy++) {
+                                gpointer key = budgie_popover_manager_cell_key(cx, cy);
+                                GPtrArray *cell = g_hash_table_lookup(self->index, key);
+
+                                if (!cell) {
+                                        cell = g_ptr_array_sized_new(2);
+                                        g_hash_table_insert(self->index, key, cell);
+                                }
+                                g_ptr_array_add(cell, entry);
+                        }
+                }
+        }
+
+        self->index_dirty = FALSE;
+        self->index_serial = budgie_geometry_cache_get_serial();
+}
+
+/**
+ * After having received an enter notify event and determining that it isn't
+ * a BudgiePopover that we entered, we look up the cell for the X, Y coordinates
+ * in our index and test the few widgets that overlap it.
+ *
+ * Upon finding a matching widget, we'll return its entry.
+ */
+static BudgiePopoverEntry *budgie_popover_manager_get_entry_for_coords(BudgiePopoverManager *self,
+                                                                       gint root_x, gint root_y)
+{
+        GPtrArray *cell = NULL;
+        gpointer key = NULL;
+
+        /* Widgets moved or were resized since we last looked */
+        if (self->index_dirty || self->index_serial != budgie_geometry_cache_get_serial()) {
+                budgie_popover_manager_rebuild_index(self);
+        }
+
+        key = budgie_popover_manager_cell_key(budgie_popover_manager_cell(root_x),
+                                              budgie_popover_manager_cell(root_y));
+        cell = g_hash_table_lookup(self->index, key);
+        if (!cell) {
+                return NULL;
+        }
+
+        for (guint i = 0; i < cell->len; i++) {
+                BudgiePopoverEntry *entry = g_ptr_array_index(cell, i);
+                GdkRectangle *rect = &entry->geometry;
+
+                /* Can't very well roll over to something that isn't on screen */
+                if (!gtk_widget_get_mapped(entry->parent_widget)) {
+                        continue;
+                }
+                if ((root_x >= rect->x && root_x <= rect->x + rect->width) &&
+                    (root_y >= rect->y && root_y <= rect->y + rect->height)) {
+                        return entry;
+                }
+        }
+
+        return NULL;
+}
+
+/**
+ * budgie_popover_manager_get_widget_at:
+ * @root_x: Absolute X coordinate on screen
+ * @root_y: Absolute Y coordinate on screen
+ *
+ * Find the registered widget at the given screen coordinates, using the same
+ * index as roll-over does.
+ *
+ * Returns: (transfer none) (nullable): The registered widget, if any
+ */
+GtkWidget *budgie_popover_manager_get_widget_at(BudgiePopoverManager *self, gint root_x,
+                                                gint root_y)
+{
+        BudgiePopoverEntry *entry = NULL;
+
+        g_assert(self != NULL);
+
+        entry = budgie_popover_manager_get_entry_for_coords(self, root_x, root_y);
+        return entry ? entry->parent_widget : NULL;
+}
+
+/**
+ * Work out which side of @active the on-screen widget for @entry is on: left,
+ * right, above or below, in that order. Same row means left or right, same
+ * column means above or below.
+ *
+ * Returns: The side, or -1 if @entry is no neighbour of @active at all
+ */
+static gint budgie_popover_manager_neighbour_side(BudgiePopoverEntry *active,
+                                                  BudgiePopoverEntry *entry, gint *distance)
+{
+        GdkRectangle *a = &active->geometry;
+        GdkRectangle *b = &entry->geometry;
+
+        if (entry == active || !entry->indexed || !gtk_widget_get_mapped(entry->parent_widget)) {
+                return -1;
+        }
+
+        if (b->y < a->y + a->height && a->y < b->y + b->height) {
+                *distance = ABS(b->x - a->x);
+                return b->x < a->x ? 0 : 1;
+        }
+        if (b->x < a->x + a->width && a->x < b->x + b->width) {
+                *distance = ABS(b->y - a->y);
+                return b->y < a->y ? 2 : 3;
+        }
+        return -1;
+}
+
+/**
+ * Walk the index outwards from @active, one row or column of cells at a
+ * time, until no cell left unvisited could hold anything nearer on @side.
+ *
+ * Returns: The nearest widget on @side, if any
+ */
+static BudgiePopoverEntry *budgie_popover_manager_nearest_on_side(BudgiePopoverManager *self,
+                                                                  BudgiePopoverEntry *active,
+                                                                  gint side)
+{
+        GdkRectangle *a = &active->geometry;
+        gboolean horizontal = side < 2;
+        gint step = side % 2 == 0 ? -1 : 1;
+        gint pos = horizontal ? a->x : a->y;
+        gint across1, across2, limit = 0;
+        BudgiePopoverEntry *nearest = NULL;
+        gint nearest_distance = 0;
+
+        /* Neighbours overlap us across the axis, so only our own cells matter there */
+        across1 = budgie_popover_manager_cell(horizontal ? a->y : a->x);
+        across2 = budgie_popover_manager_cell(horizontal ? a->y + a->height : a->x + a->width);
+        if (step < 0) {
+                limit = horizontal ? self->index_x1 : self->index_y1;
+        } else {
+                limit = horizontal ? self->index_x2 : self->index_y2;
+        }
+
+        for (gint c = budgie_popover_manager_cell(pos); step < 0 ? c >= limit : c <= limit;
+             c += step) {
+                gint reach = 0;
+
+                for (gint d = across1; d <= across2; d++) {
+                        gpointer key = horizontal ? budgie_popover_manager_cell_key(c, d)
+                                                  : budgie_popover_manager_cell_key(d, c);
+                        GPtrArray *cell = g_hash_table_lookup(self->index, key);
+
+                        for (guint i = 0; cell && i < cell->len; i++) {
+                                BudgiePopoverEntry *entry = g_ptr_array_index(cell, i);
+                                gint distance = 0;
+
+                                if (budgie_popover_manager_neighbour_side(active,
+                                                                          entry,
+                                                                          &distance) != side) {
+                                        continue;
+                                }
+                                if (!nearest || distance < nearest_distance) {
+                                        nearest = entry;
+                                        nearest_distance = distance;
+                                }
+                        }
+                }
+
+                /* Anything we haven't seen yet lies wholly beyond this cell */
+                reach = step < 0 ? pos - c * INDEX_CELL_SIZE : (c + 1) * INDEX_CELL_SIZE - pos;
+                if (nearest && nearest_distance <= reach) {
+                        break;
+                }
+        }
+
+        return nearest;
+}
+
+/**
+ * Stamp the nearest on-screen widget in each direction from @active as
+ * recently used, so that roll-over from @active always finds them warm.
+ * Only the cells around @active are visited, however many are registered.
+ */
+static void budgie_popover_manager_touch_neighbours(BudgiePopoverManager *self,
+                                                    BudgiePopoverEntry *active)
+{
+        if (self->index_dirty || self->index_serial != budgie_geometry_cache_get_serial()) {
+                budgie_popover_manager_rebuild_index(self);
+        }
+        if (!active->indexed || !gtk_widget_get_mapped(active->parent_widget)) {
+                return;
+        }
+
+        for (gint side = 0; side < 4; side++) {
+                BudgiePopoverEntry *nearest = NULL;
+
+                nearest = budgie_popover_manager_nearest_on_side(self, active, side);
+                if (nearest) {
+                        budgie_popover_manager_touch(self, nearest);
+                }
+        }
+}
+
+/**
+ * Grab the seat for @popover. During a menu session this just moves the
+ * existing grab to the new window, without releasing it first.
+ */
+static void budgie_popover_manager_grab_session(BudgiePopoverManager *self,
+                                                BudgiePopover *popover)
+{
+        GdkWindow *window = NULL;
+        GdkSeat *seat = NULL;
+        GdkGrabStatus st;
+        gint64 start = 0;
+
+        window = gtk_widget_get_window(GTK_WIDGET(popover));
+        if (!window || window == self->grab_window) {
+                return;
+        }
+
+        seat = gdk_display_get_default_seat(gtk_widget_get_display(GTK_WIDGET(popover)));
+
+        start = g_get_monotonic_time();
+        st = gdk_seat_grab(seat, window, GDK_SEAT_CAPABILITY_ALL, TRUE, NULL, NULL, NULL, NULL);
+        start = g_get_monotonic_time() - start;
+        budgie_stats_record(&self->stats, BUDGIE_STATS_GRAB, start);
+
+        if (st == GDK_GRAB_SUCCESS) {
+                self->grab_seat = seat;
+                self->grab_window = window;
+        }
+}
+
+/**
+ * The menu session is over, so give the seat back
+ */
+static void budgie_popover_manager_ungrab_session(BudgiePopoverManager *self)
+{
+        gint64 start = 0;
+
+        if (!self->grab_seat) {
+                return;
+        }
+
+        start = g_get_monotonic_time();
+        gdk_seat_ungrab(self->grab_seat);
+        budgie_stats_record(&self->stats, BUDGIE_STATS_UNGRAB, g_get_monotonic_time() - start);
+
+        self->grab_seat = NULL;
+        self->grab_window = NULL;
+}
+
+/**
+ * Someone else took the seat from us, so we no longer hold the session grab
+ */
+void budgie_popover_manager_popover_grab_broken(BudgiePopoverManager *self,
+                                                BudgiePopover *popover)
+{
+        if (gtk_widget_get_window(GTK_WIDGET(popover)) == self->grab_window) {
+                self->grab_seat = NULL;
+                self->grab_window = NULL;
+        }
+}
+
+/**
+ * Handle the BudgiePopover becoming visible on screen, updating our knowledge
+ * of who the currently active popover is
+ */
+void budgie_popover_manager_popover_mapped(BudgiePopoverManager *self, BudgiePopover *popover)
+{
+        BudgiePopoverEntry *entry = NULL;
+        BudgiePopover *old = NULL;
+
+        self->active_popover = popover;
+        budgie_popover_manager_route_events(self, popover);
+
+        /* Take over the grab before the old popover goes away */
+        budgie_popover_manager_grab_session(self, popover);
+        if (self->pending_hide && self->pending_hide != popover) {
+                old = self->pending_hide;
+                self->pending_hide = NULL;
+                gtk_widget_hide(GTK_WIDGET(old));
+        }
+
+        /* Did the warm pool pay for this one in advance? */
+        if (popover == self->cold_popover) {
+                self->cold_popover = NULL;
+                budgie_stats_count(&self->stats, BUDGIE_STATS_COLD_OPENS);
+        } else {
+                budgie_stats_count(&self->stats, BUDGIE_STATS_WARM_OPENS);
+        }
+
+        if (popover == self->shared_popover) {
+                entry = g_hash_table_lookup(self->popovers, self->shared_widget);
+        } else {
+                entry = g_hash_table_lookup(self->popover_entries, popover);
+        }
+        if (entry) {
+                budgie_popover_manager_touch(self, entry);
+                budgie_popover_manager_touch_neighbours(self, entry);
+        }
+        budgie_popover_manager_queue_warm(self);
+}
+
+/**
+ * Handle the BudgiePopover becoming invisible on screen, updating our knowledge
+ * of who the currently active popover is
+ */
+void budgie_popover_manager_popover_unmapped(BudgiePopoverManager *self,
+                                             BudgiePopover *popover)
+{
+        if (popover == self->pending_hide) {
+                self->pending_hide = NULL;
+        }
+        if (popover == self->active_popover) {
+                self->active_popover = NULL;
+                budgie_popover_manager_route_events(self, NULL);
+                budgie_popover_manager_ungrab_session(self);
+        }
+        if (popover == self->shared_popover && self->shared_widget) {
+                budgie_popover_manager_content_hidden(self, self->shared_widget);
+        }
+        budgie_popover_manager_queue_warm(self);
+}
+
+/**
+ * A popover was realized. If we weren't the ones doing it, it's being shown
+ * without having been warmed up first.
+ */
+void budgie_popover_manager_popover_realized(BudgiePopoverManager *self,
+                                             BudgiePopover *popover)
+{
+        BudgiePopoverEntry *entry = NULL;
+
+        if (popover != self->warming) {
+                self->cold_popover = popover;
+        }
+
+        entry = g_hash_table_lookup(self->popover_entries, popover);
+        if (entry) {
+                budgie_popover_manager_lru_move(entry, &self->warm);
+        }
+}
+
+/**
+ * A popover was unrealized, whether by us or not, so it no longer takes up
+ * room in the warm pool
+ */
+void budgie_popover_manager_popover_unrealized(BudgiePopoverManager *self,
+                                               BudgiePopover *popover)
+{
+        BudgiePopoverEntry *entry = NULL;
+
+        entry = g_hash_table_lookup(self->popover_entries, popover);
+        if (entry) {
+                budgie_popover_manager_lru_move(entry, &self->cold);
+        }
+}
+
+/**
+ * Move @entry into @queue, or out of the pool entirely if @queue is NULL.
+ * Both queues are kept in most recently used order, and only entries used
+ * since @entry was are walked past to find its place.
+ */
+static void budgie_popover_manager_lru_move(BudgiePopoverEntry *entry, GQueue *queue)
+{
+        GList *sibling = NULL;
+
+        if (entry->lru_queue == queue) {
+                return;
+        }
+        if (entry->lru_queue) {
+                g_queue_delete_link(entry->lru_queue, entry->lru_link);
+                entry->lru_queue = NULL;
+                entry->lru_link = NULL;
+        }
+        if (!queue) {
+                return;
+        }
+
+        sibling = queue->head;
+        while (sibling && ((BudgiePopoverEntry *)sibling->data)->last_used > entry->last_used) {
+                sibling = sibling->next;
+        }
+        if (sibling) {
+                g_queue_insert_before(queue, sibling, entry);
+                entry->lru_link = sibling->prev;
+        } else {
+                g_queue_push_tail(queue, entry);
+                entry->lru_link = queue->tail;
+        }
+        entry->lru_queue = queue;
+}
+
+/**
+ * Mark @entry as the most recently used
+ */
+static void budgie_popover_manager_touch(BudgiePopoverManager *self, BudgiePopoverEntry *entry)
+{
+        entry->last_used = ++self->use_serial;
+        if (entry->lru_queue) {
+                g_queue_unlink(entry->lru_queue, entry->lru_link);
+                g_queue_push_head_link(entry->lru_queue, entry->lru_link);
+        }
+}
+
+/**
+ * Find the next popover that deserves to be warmed up. Neighbours of the open
+ * popover are stamped as recently used, so the most recently used cold entry
+ * is the right choice in either case.
+ */
+static BudgiePopoverEntry *budgie_popover_manager_next_cold(BudgiePopoverManager *self)
+{
+        return self->cold.head ? self->cold.head->data : NULL;
+}
+
+/**
+ * Make room in the pool for @target by unrealizing the least recently used
+ * warm popover, provided it was used less recently than @target. Only the
+ * realized popovers are looked at, so this is bounded by the pool rather
+ * than by the number of registrations.
+ *
+ * Entries in the shared popover never enter the pool themselves. The shared
+ * window takes up a single slot while realized, and is never evicted while
+ * anything is still registered to show in it.
+ *
+ * Returns: TRUE if there is room for @target
+ */
+static gboolean budgie_popover_manager_make_room(BudgiePopoverManager *self,
+                                                 BudgiePopoverEntry *target)
+{
+        BudgiePopoverEntry *lru = NULL;
+        guint n_warm = 0;
+
+        if (self->n_shared > 0 && self->shared_popover &&
+            gtk_widget_get_realized(GTK_WIDGET(self->shared_popover)) &&
+            !gtk_widget_get_visible(GTK_WIDGET(self->shared_popover))) {
+                n_warm++;
+        }
+
+        /* Visible popovers are realized too, but aren't part of the pool */
+        for (GList *link = self->warm.tail; link; link = link->prev) {
+                BudgiePopoverEntry *entry = link->data;
+
+                if (gtk_widget_get_visible(GTK_WIDGET(entry->popover))) {
+                        continue;
+                }
+                n_warm++;
+                if (!lru) {
+                        lru = entry;
+                }
+        }
+
+        if (n_warm < self->warm_budget) {
+                return TRUE;
+        }
+
+        if (!lru || lru->last_used >= target->last_used) {
+                return FALSE;
+        }
+
+        gtk_widget_unrealize(GTK_WIDGET(lru->popover));
+        return TRUE;
+}
+
+/**
+ * Warm up a single popover per idle iteration to keep the main loop responsive
+ */
+static gboolean budgie_popover_manager_warm_one(gpointer v)
+{
+        BudgiePopoverManager *self = v;
+        BudgiePopoverEntry *entry = NULL;
+
+        entry = budgie_popover_manager_next_cold(self);
+        if (!entry || !budgie_popover_manager_make_room(self, entry)) {
+                self->warm_source = 0;
+                return G_SOURCE_REMOVE;
+        }
+
+        self->warming = entry->popover;
+        budgie_popover_prepare(entry->popover);
+        self->warming = NULL;
+
+        return G_SOURCE_CONTINUE;
+}
+
+/**
+ * Schedule the warm pool to be topped up once we're otherwise idle
+ */
+static void budgie_popover_manager_queue_warm(BudgiePopoverManager *self)
+{
+        if (self->warm_source > 0 || self->warm_budget == 0) {
+                return;
+        }
+        self->warm_source =
+            g_idle_add_full(G_PRIORITY_LOW, budgie_popover_manager_warm_one, self, NULL);
+}
+
+/**
+ * budgie_popover_manager_set_warm_budget:
+ * @budget: Maximum number of hidden popovers to keep realized
+ *
+ * Control how many hidden popovers may be kept realized and measured ahead of
+ * being shown. A budget of 0 disables the warm pool, along with
+ * speculating on hover.
+ */
+void budgie_popover_manager_set_warm_budget(BudgiePopoverManager *self, guint budget)
+{
+        g_assert(self != NULL);
+
+        self->warm_budget = budget;
+        budgie_popover_manager_queue_warm(self);
+}
+
+/**
+ * Is the content for @entry on screen right now?
+ */
+static gboolean budgie_popover_manager_content_visible(BudgiePopoverManager *self,
+                                                       BudgiePopoverEntry *entry)
+{
+        return self->shared_widget == entry->parent_widget &&
+               gtk_widget_get_visible(GTK_WIDGET(self->shared_popover));
+}
+
+/**
+ * Throw away factory content that has been hidden for long enough, keeping
+ * the timer going while there is still hidden content left to expire.
+ */
+static gboolean budgie_popover_manager_release_content(gpointer v)
+{
+        BudgiePopoverManager *self = v;
+        GHashTableIter iter = { 0 };
+        BudgiePopoverEntry *entry = NULL;
+        gint64 now = g_get_monotonic_time();
+        gint64 timeout = (gint64)self->content_timeout * G_USEC_PER_SEC;
+        gboolean pending = FALSE;
+
+        g_hash_table_iter_init(&iter, self->popovers);
+        while (g_hash_table_iter_next(&iter, NULL, (void **)&entry)) {
+                if (!entry->factory || !entry->content ||
+                    budgie_popover_manager_content_visible(self, entry)) {
+                        continue;
+                }
+                if (now - entry->hidden_since < timeout) {
+                        pending = TRUE;
+                        continue;
+                }
+
+                /* Don't leave the shared popover pointing at dead content */
+                if (self->shared_widget == entry->parent_widget) {
+                        budgie_popover_manager_release_shared(self, entry->parent_widget);
+                }
+                budgie_popover_entry_release_content(entry);
+        }
+
+        if (!pending) {
+                self->content_source = 0;
+        }
+        return pending ? G_SOURCE_CONTINUE : G_SOURCE_REMOVE;
+}
+
+/**
+ * The content for @parent_widget just went off screen, so start its clock
+ */
+static void budgie_popover_manager_content_hidden(BudgiePopoverManager *self,
+                                                  GtkWidget *parent_widget)
+{
+        BudgiePopoverEntry *entry = NULL;
+
+        entry = g_hash_table_lookup(self->popovers, parent_widget);
+        if (!entry || !entry->factory) {
+                return;
+        }
+
+        entry->hidden_since = g_get_monotonic_time();
+
+        if (self->content_source > 0 || self->content_timeout == 0) {
+                return;
+        }
+        self->content_source = g_timeout_add_seconds(self->content_timeout,
+                                                     budgie_popover_manager_release_content,
+                                                     self);
+}
+
+/**
+ * budgie_popover_manager_set_content_timeout:
+ * @seconds: Seconds that factory content may stay hidden, or 0 to keep it forever
+ *
+ * Control how long content built by a factory is kept around after hiding
+ */
+void budgie_popover_manager_set_content_timeout(BudgiePopoverManager *self, guint seconds)
+{
+        g_assert(self != NULL);
+
+        self->content_timeout = seconds;
+        if (self->content_source > 0) {
+                g_source_remove(self->content_source);
+                self->content_source = 0;
+        }
+        if (seconds > 0) {
+                self->content_source = g_timeout_add_seconds(seconds,
+                                                             budgie_popover_manager_release_content,
+                                                             self);
+        }
+}
+
+/**
+ * budgie_popover_manager_get_resident_content:
+ *
+ * Returns: The number of shared content trees currently held in memory
+ */
+guint budgie_popover_manager_get_resident_content(BudgiePopoverManager *self)
+{
+        GHashTableIter iter = { 0 };
+        BudgiePopoverEntry *entry = NULL;
+        guint n_resident = 0;
+
+        g_assert(self != NULL);
+
+        g_hash_table_iter_init(&iter, self->popovers);
+        while (g_hash_table_iter_next(&iter, NULL, (void **)&entry)) {
+                if (entry->content) {
+                        n_resident++;
+                }
+        }
+        return n_resident;
+}
+
+/**
+ * budgie_popover_manager_get_stats:
+ * @stats: (out): Location to store the statistics
+ *
+ * Gather the performance statistics for the manager and every popover it
+ * manages into @stats. The popovers record their own show, placement and
+ * draw timings, while the manager records grabs, roll-overs and whether
+ * each open was warm or cold.
+ */
+void budgie_popover_manager_get_stats(BudgiePopoverManager *self, BudgieStats *stats)
+{
+        GHashTableIter iter = { 0 };
+        BudgiePopoverEntry *entry = NULL;
+
+        g_assert(self != NULL);
+
+        *stats = self->stats;
+
+        g_hash_table_iter_init(&iter, self->popovers);
+        while (g_hash_table_iter_next(&iter, NULL, (void **)&entry)) {
+                if (!entry->shared && entry->popover) {
+                        budgie_stats_merge(stats, budgie_popover_get_stats(entry->popover));
+                }
+        }
+        if (self->shared_popover) {
+                budgie_stats_merge(stats, budgie_popover_get_stats(self->shared_popover));
+        }
+}
+
+/**
+ * budgie_popover_manager_dump_stats:
+ * @path: File to write the statistics to
+ *
+ * Write the gathered statistics to @path as JSON. This also happens
+ * automatically on SIGUSR1 and when the manager is disposed, if the
+ * BUDGIE_POPOVER_STATS environment variable names a file.
+ *
+ * Returns: TRUE if the statistics were written
+ */
+gboolean budgie_popover_manager_dump_stats(BudgiePopoverManager *self, const gchar *path)
+{
+        BudgieStats stats;
+        GError *error = NULL;
+        gchar *json = NULL;
+        gboolean ret = FALSE;
+
+        g_assert(self != NULL);
+
+        budgie_popover_manager_get_stats(self, &stats);
+        json = budgie_stats_to_json(&stats);
+
+        ret = g_file_set_contents(path, json, -1, &error);
+        if (!ret) {
+                g_warning("dump_stats(): Failed to write %s: %s", path, error->message);
+                g_error_free(error);
+        }
+        g_free(json);
+        return ret;
+}
+
+static gboolean budgie_popover_manager_stats_signalled(gpointer v)
+{
+        BudgiePopoverManager *self = v;
+
+        budgie_popover_manager_dump_stats(self, self->stats_path);
+        return G_SOURCE_CONTINUE;
 }
 
 /*
@@ -32,6 +32,17 @@ typedef struct _BudgiePopoverManagerClass BudgiePopoverManagerClass;
 #define BUDGIE_POPOVER_MANAGER_GET_CLASS(o)                                                        \
         (G_TYPE_INSTANCE_GET_CLASS((o), BUDGIE_TYPE_POPOVER_MANAGER, BudgiePopoverManagerClass))
 
+/**
+ * BudgiePopoverContentFunc:
+ * @parent_widget: Widget that the content is being built for
+ * @udata: User data passed at registration
+ *
+ * Build the content to display in the popover for @parent_widget
+ *
+ * Returns: (transfer floating): A new content widget
+ */
+typedef GtkWidget *(*BudgiePopoverContentFunc)(GtkWidget *parent_widget, gpointer udata);
+
 BudgiePopoverManager *budgie_popover_manager_new(void);
 
 GType budgie_popover_manager_get_type(void);
@@ -41,9 +52,22 @@ GType budgie_popover_manager_get_type(void);
  */
 void budgie_popover_manager_register_popover(BudgiePopoverManager *manager,
                                              GtkWidget *parent_widget, BudgiePopover *popover);
+void budgie_popover_manager_register_content(BudgiePopoverManager *manager,
+                                             GtkWidget *parent_widget, GtkWidget *content);
+void budgie_popover_manager_register_factory(BudgiePopoverManager *manager,
+                                             GtkWidget *parent_widget,
+                                             BudgiePopoverContentFunc factory, gpointer udata,
+                                             GDestroyNotify notify);
 void budgie_popover_manager_unregister_popover(BudgiePopoverManager *manager,
                                                GtkWidget *parent_widget);
 void budgie_popover_manager_show_popover(BudgiePopoverManager *manager, GtkWidget *parent_widget);
+GtkWidget *budgie_popover_manager_get_widget_at(BudgiePopoverManager *manager, gint root_x,
+                                                gint root_y);
+void budgie_popover_manager_set_warm_budget(BudgiePopoverManager *manager, guint budget);
+void budgie_popover_manager_set_content_timeout(BudgiePopoverManager *manager, guint seconds);
+guint budgie_popover_manager_get_resident_content(BudgiePopoverManager *manager);
+void budgie_popover_manager_get_stats(BudgiePopoverManager *manager, BudgieStats *stats);
+gboolean budgie_popover_manager_dump_stats(BudgiePopoverManager *manager, const gchar *path);
 
 G_END_DECLS
 
@@ -0,0 +1,285 @@
+/*
+ * This file is part of ui-tests
+ *
+ * Copyright © 2016-2017 Ikey Doherty <ikey@solus-project.com>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ */
+
+#define _GNU_SOURCE
+
+#include "util.h"
+
+BUDGIE_BEGIN_PEDANTIC
+#include "popover-placement.h"
+#include <string.h>
+BUDGIE_END_PEDANTIC
+
+/**
+ * Select the position based on the amount of space available in the given
+ * regions.
+ *
+ * Typically we'll always try to display underneath first, and failing that
+ * we'll try to appear above.  If we're still estate-limited, we'll then try
+ * the right hand side, before finally falling back to the left hand side for display.
+ *
+ * The side options will also utilise Y-offsets and bounding to ensure there
+ * is always some way to fit the popover sanely on screen.
+ */
+static BudgiePlacementEdge budgie_placement_select_automatic(const BudgiePlacementInput *input)
+{
+        const BudgiePlacementRect *screen_rect = &input->monitor;
+        const BudgiePlacementRect *widget_rect = &input->anchor;
+        gint tail_height = input->tail_dimension / 2;
+
+        /* Try to show the popover underneath */
+        if (widget_rect->y + widget_rect->height + tail_height + input->shadow_dimension +
+                input->height <=
+            screen_rect->y + screen_rect->height) {
+                return BUDGIE_PLACEMENT_EDGE_TOP;
+        }
+
+        /* Now try to show the popover above the widget */
+        if (widget_rect->y - tail_height - input->shadow_dimension - input->height >=
+            screen_rect->y) {
+                return BUDGIE_PLACEMENT_EDGE_BOTTOM;
+        }
+
+        /* Work out which has more room, left or right. */
+        double room_right =
+            screen_rect->x + screen_rect->width - (widget_rect->x + widget_rect->width);
+        double room_left = widget_rect->x - screen_rect->x;
+
+        if (room_left > room_right) {
+                return BUDGIE_PLACEMENT_EDGE_RIGHT;
+        }
+
+        return BUDGIE_PLACEMENT_EDGE_LEFT;
+}
+
+/**
+ * budgie_placement_compute_tail:
+ * @edge: Edge of the popover that the tail sits on
+ * @area: Area of the popover window
+ * @tail: (out): Location to store the tail
+ *
+ * Compute the tail for the given edge of @area, centred along that edge and
+ * without any offsets applied.
+ */
+void budgie_placement_compute_tail(BudgiePlacementEdge edge, const BudgiePlacementRect *area,
+                                   gint tail_dimension, gint shadow_dimension, BudgieTail *tail)
+{
+        BudgieTail t = { 0 };
+        gint tail_height = tail_dimension / 2;
+
+        t.position = edge;
+
+        switch (edge) {
+        case BUDGIE_PLACEMENT_EDGE_LEFT:
+                t.x = area->x;
+                t.y = area->y + (area->height / 2);
+                t.start_y = t.y - tail_height;
+                t.end_y = t.y + tail_height;
+                t.start_x = t.end_x = t.x + tail_height + shadow_dimension;
+                break;
+        case BUDGIE_PLACEMENT_EDGE_RIGHT:
+                t.x = area->width;
+                t.y = area->y + (area->height / 2);
+                t.start_y = t.y - tail_height;
+                t.end_y = t.y + tail_height;
+                t.start_x = t.end_x = t.x - tail_height - shadow_dimension;
+                break;
+        case BUDGIE_PLACEMENT_EDGE_TOP:
+                t.x = (area->x + area->width / 2);
+                t.y = area->y;
+                t.start_x = t.x - tail_height;
+                t.end_x = t.start_x + tail_dimension;
+                t.start_y = t.y + tail_height;
+                t.end_y = t.start_y;
+                break;
+        case BUDGIE_PLACEMENT_EDGE_BOTTOM:
+        default:
+                t.x = (area->x + area->width / 2);
+                t.y = (area->y + area->height) - shadow_dimension;
+                t.start_x = t.x - tail_height;
+                t.end_x = t.start_x + tail_dimension;
+                t.start_y = t.y - tail_height;
+                t.end_y = t.start_y;
+                break;
+        }
+
+        *tail = t;
+}
+
+/**
+ * budgie_placement_compute:
+ * @input: Anchor, monitor and popover geometry
+ * @placement: (out): Location to store the result
+ *
+ * Work out exactly where the popover needs to appear on screen
+ *
+ * This will try to account for all potential positions, using a fairly
+ * biased view of what the popover should do in each situation.
+ *
+ * Unlike a typical popover implementation, this relies on some information
+ * from the toplevel window on what edge it happens to be on, which is passed
+ * in as @input->edge when not using automatic placement.
+ */
+void budgie_placement_compute(const BudgiePlacementInput *input, BudgiePlacement *placement)
+{
+        const BudgiePlacementRect *widget_rect = &input->anchor;
+        const BudgiePlacementRect *display_geom = &input->monitor;
+        BudgiePlacementEdge tail_position = BUDGIE_PLACEMENT_EDGE_BOTTOM;
+        BudgiePlacementRect area = { 0 };
+        BudgiePlacementMargin margin = { 0 };
+        BudgieTail *tail = &(placement->tail);
+        gint our_width = input->width;
+        gint our_height = input->height;
+        gint tail_dimension = input->tail_dimension;
+        int x = 0, y = 0;
+        int spill = 0;
+        const int pad_num = 1;
+        const double required_offset_x = tail_dimension * 1.25;
+        const double required_offset_y = tail_dimension * 1.75;
+
+        if (input->automatic) {
+                tail_position = budgie_placement_select_automatic(input);
+        } else {
+                tail_position = input->edge;
+        }
+
+        /* Now work out where we live on screen */
+        switch (tail_position) {
+        case BUDGIE_PLACEMENT_EDGE_BOTTOM:
+                /* We need to appear above the widget */
+                y = widget_rect->y - our_height;
+                x = (widget_rect->x + (widget_rect->width / 2)) - (our_width / 2);
+                margin = (BudgiePlacementMargin){.top = 5, .bottom = 15, .start = 5, .end = 5 };
+                break;
+        case BUDGIE_PLACEMENT_EDGE_TOP:
+                /* We need to appear below the widget */
+                y = widget_rect->y + widget_rect->height + (tail_dimension / 2);
+                x = (widget_rect->x + (widget_rect->width / 2)) - (our_width / 2);
+                margin = (BudgiePlacementMargin){.top = 10, .bottom = 10, .start = 5, .end = 5 };
+                break;
+        case BUDGIE_PLACEMENT_EDGE_LEFT:
+                /* We need to appear to the right of the widget */
+                y = (widget_rect->y + (widget_rect->height / 2)) - (our_height / 2);
+                y += tail_dimension / 4;
+                x = widget_rect->x + widget_rect->width;
+                margin = (BudgiePlacementMargin){.top = 5, .bottom = 10, .start = 15, .end = 5 };
+                break;
+        case BUDGIE_PLACEMENT_EDGE_RIGHT:
+                y = (widget_rect->y + (widget_rect->height / 2)) - (our_height / 2);
+                y += tail_dimension / 4;
+                x = widget_rect->x - our_width;
+                margin = (BudgiePlacementMargin){.top = 5, .bottom = 10, .start = 5, .end = 15 };
+                break;
+        default:
+                break;
+        }
+
+        /* Work out the tail for our current size */
+        area = (BudgiePlacementRect){.x = 0, .y = 0, .width = our_width, .height = our_height };
+        budgie_placement_compute_tail(tail_position,
+                                      &area,
+                                      tail_dimension,
+                                      input->shadow_dimension,
+                                      tail);
+
+        /* Bound X to display width */
+        if (x < display_geom->x) {
+                tail->x_offset += (x - (display_geom->x + pad_num));
+                x -= (int)(tail->x_offset);
+        } else if ((x + our_width) >= display_geom->x + display_geom->width) {
+                tail->x_offset -=
+                    ((display_geom->x + display_geom->width) - (our_width + pad_num)) - x;
+                x -= (int)(tail->x_offset);
+        }
+
+        double display_tail_x = x + tail->x + tail->x_offset;
+        double display_tail_y = y + tail->y + tail->y_offset;
+
+        /* Prevent the tail pointer spilling outside the X bounds */
+        if (display_tail_x <= display_geom->x + required_offset_x) {
+                tail->x_offset += (display_geom->x + required_offset_x) - display_tail_x;
+        } else if (display_tail_x >=
+                   ((display_geom->x + display_geom->width) - required_offset_x)) {
+                tail->x_offset -=
+                    (display_tail_x + required_offset_x) - (display_geom->x + display_geom->width);
+        }
+
+        /* Prevent the tail pointer spilling outside the Y bounds */
+        if (display_tail_y <= display_geom->y + required_offset_y) {
+                tail->y_offset += (display_geom->y + required_offset_y) - display_tail_y;
+        } else if (display_tail_y >=
+                   ((display_geom->y + display_geom->height) - required_offset_y)) {
+                tail->y_offset -=
+                    (display_tail_y + required_offset_y) - (display_geom->y + display_geom->height);
+        }
+
+        /* Bound Y to display height. The tail may already have been offset
+         * above, so only move the window by the amount that it spills over. */
+        if (y < display_geom->y) {
+                spill = y - (display_geom->y + pad_num);
+        } else if ((y + our_height) >= display_geom->y + display_geom->height) {
+                spill = y - ((display_geom->y + display_geom->height) - (our_height + pad_num));
+        }
+        tail->y_offset += spill;
+        y -= spill;
+
+        placement->x = x;
+        placement->y = y;
+        placement->margin = margin;
+}
+
+/**
+ * budgie_placement_memo_compute:
+ * @memo: Memo to consult and update
+ * @input: Placement input, which must be zeroed before filling so that any
+ *         struct padding compares equal
+ * @placement: (out): Location to store the result
+ *
+ * Return a remembered placement for @input if we have one, otherwise compute
+ * it and remember it in place of the oldest entry.
+ *
+ * Returns: TRUE if the placement came from the memo
+ */
+gboolean budgie_placement_memo_compute(BudgiePlacementMemo *memo,
+                                       const BudgiePlacementInput *input,
+                                       BudgiePlacement *placement)
+{
+        for (guint i = 0; i < memo->n_entries; i++) {
+                if (memcmp(&memo->keys[i], input, sizeof(*input)) != 0) {
+                        continue;
+                }
+                *placement = memo->results[i];
+                return TRUE;
+        }
+
+        budgie_placement_compute(input, placement);
+
+        memo->keys[memo->next] = *input;
+        memo->results[memo->next] = *placement;
+        memo->next = (memo->next + 1) % BUDGIE_PLACEMENT_MEMO_SIZE;
+        if (memo->n_entries < BUDGIE_PLACEMENT_MEMO_SIZE) {
+                ++memo->n_entries;
+        }
+        return FALSE;
+}
+
+/*
+ * Editor modelines  -  https://www.wireshark.org/tools/modelines.html
+ *
+ * Local variables:
+ * c-basic-offset: 8
+ * tab-width: 8
+ * indent-tabs-mode: nil
+ * End:
+ *
+ * vi: set shiftwidth=8 tabstop=8 expandtab:
+ * :indentSize=8:tabSize=8:noTabs=true:
+ */
@@ -0,0 +1,125 @@
+/*
+ * This file is part of ui-tests
+ *
+ * Copyright © 2016-2017 Ikey Doherty <ikey@solus-project.com>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ */
+
+#pragma once
+
+#include <glib.h>
+
+G_BEGIN_DECLS
+
+/**
+ * Placement is pure math, so it doesn't depend on GTK and can be exercised
+ * in isolation. Nothing in here allocates.
+ */
+
+/**
+ * BudgiePlacementEdge:
+ *
+ * The edge of the popover that the tail sits on. These deliberately share
+ * their values with GtkPositionType.
+ */
+typedef enum {
+        BUDGIE_PLACEMENT_EDGE_LEFT = 0,
+        BUDGIE_PLACEMENT_EDGE_RIGHT,
+        BUDGIE_PLACEMENT_EDGE_TOP,
+        BUDGIE_PLACEMENT_EDGE_BOTTOM,
+} BudgiePlacementEdge;
+
+typedef struct BudgiePlacementRect {
+        gint x;
+        gint y;
+        gint width;
+        gint height;
+} BudgiePlacementRect;
+
+typedef struct BudgiePlacementMargin {
+        gint top;
+        gint bottom;
+        gint start;
+        gint end;
+} BudgiePlacementMargin;
+
+/**
+ * Used for storing BudgieTail calculations
+ */
+typedef struct BudgieTail {
+        double start_x;
+        double start_y;
+        double end_x;
+        double end_y;
+        double x;
+        double y;
+        double x_offset;
+        double y_offset;
+        BudgiePlacementEdge position;
+} BudgieTail;
+
+/**
+ * Everything needed to place a popover
+ */
+typedef struct BudgiePlacementInput {
+        BudgiePlacementRect anchor;  /* Absolute geometry of the relative-to widget */
+        BudgiePlacementRect monitor; /* Monitor that the anchor lives on */
+        gint width;                  /* Size of the popover window */
+        gint height;
+        gboolean automatic; /* Pick the edge by available space, otherwise use @edge */
+        BudgiePlacementEdge edge;
+        gint tail_dimension;
+        gint shadow_dimension;
+} BudgiePlacementInput;
+
+/**
+ * Result of a placement pass: window origin, tail and content margins
+ */
+typedef struct BudgiePlacement {
+        gint x;
+        gint y;
+        BudgiePlacementMargin margin;
+        BudgieTail tail;
+} BudgiePlacement;
+
+/**
+ * Number of recent placements remembered by a BudgiePlacementMemo
+ */
+#define BUDGIE_PLACEMENT_MEMO_SIZE 4
+
+/**
+ * Small ring of recent placement results, keyed on the full input. Repeat
+ * opens of the same popover in the same spot skip the computation entirely.
+ */
+typedef struct BudgiePlacementMemo {
+        BudgiePlacementInput keys[BUDGIE_PLACEMENT_MEMO_SIZE];
+        BudgiePlacement results[BUDGIE_PLACEMENT_MEMO_SIZE];
+        guint n_entries;
+        guint next;
+} BudgiePlacementMemo;
+
+void budgie_placement_compute(const BudgiePlacementInput *input, BudgiePlacement *placement);
+gboolean budgie_placement_memo_compute(BudgiePlacementMemo *memo,
+                                       const BudgiePlacementInput *input,
+                                       BudgiePlacement *placement);
+void budgie_placement_compute_tail(BudgiePlacementEdge edge, const BudgiePlacementRect *area,
+                                   gint tail_dimension, gint shadow_dimension, BudgieTail *tail);
+
+G_END_DECLS
+
+/*
+ * Editor modelines  -  https://www.wireshark.org/tools/modelines.html
+ *
+ * Local variables:
+ * c-basic-offset: 8
+ * tab-width: 8
+ * indent-tabs-mode: nil
+ * End:
+ *
+ * vi: set shiftwidth=8 tabstop=8 expandtab:
+ * :indentSize=8:tabSize=8:noTabs=true:
+ */
@@ -0,0 +1,58 @@
+/*
+ * This file is part of ui-tests
+ *
+ * Copyright © 2016-2017 Ikey Doherty <ikey@solus-project.com>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ */
+
+#pragma once
+
+#include <gtk/gtk.h>
+
+#include "popover-manager.h"
+#include "popover.h"
+
+G_BEGIN_DECLS
+
+/**
+ * Internal plumbing between BudgiePopover and BudgiePopoverManager. A
+ * managed popover reports its own state changes straight to the manager from
+ * its class vfuncs, so the manager needs no signal handlers on it. The
+ * manager in turn passes on screen and toplevel changes, so its popovers need
+ * no handlers on those either.
+ */
+
+void budgie_popover_set_manager(BudgiePopover *popover, BudgiePopoverManager *manager);
+void budgie_popover_set_show_start(BudgiePopover *popover, gint64 requested);
+void budgie_popover_composited_changed(BudgiePopover *popover);
+void budgie_popover_toplevel_style_changed(BudgiePopover *popover, GtkWidget *toplevel);
+
+void budgie_popover_manager_popover_mapped(BudgiePopoverManager *manager, BudgiePopover *popover);
+void budgie_popover_manager_popover_unmapped(BudgiePopoverManager *manager,
+                                             BudgiePopover *popover);
+void budgie_popover_manager_popover_realized(BudgiePopoverManager *manager,
+                                             BudgiePopover *popover);
+void budgie_popover_manager_popover_unrealized(BudgiePopoverManager *manager,
+                                               BudgiePopover *popover);
+void budgie_popover_manager_popover_grab_broken(BudgiePopoverManager *manager,
+                                                BudgiePopover *popover);
+void budgie_popover_manager_popover_died(BudgiePopoverManager *manager, BudgiePopover *popover);
+
+G_END_DECLS
+
+/*
+ * Editor modelines  -  https://www.wireshark.org/tools/modelines.html
+ *
+ * Local variables:
+ * c-basic-offset: 8
+ * tab-width: 8
+ * indent-tabs-mode: nil
+ * End:
+ *
+ * vi: set shiftwidth=8 tabstop=8 expandtab:
+ * :indentSize=8:tabSize=8:noTabs=true:
+ */
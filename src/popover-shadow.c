@@ -0,0 +1,259 @@
+/*
+ * This file is part of ui-tests
+ *
+ * Copyright © 2016-2017 Ikey Doherty <ikey@solus-project.com>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ */
+
+#define _GNU_SOURCE
+
+#include "util.h"
+#include <string.h>
+
+BUDGIE_BEGIN_PEDANTIC
+#include "popover-shadow.h"
+#include <gtk/gtk.h>
+BUDGIE_END_PEDANTIC
+
+/**
+ * Number of blurred masks kept around. We mostly need one per chrome
+ * template (i.e. tail position), with some room for the full size fallback.
+ */
+#define BUDGIE_SHADOW_CACHE_SIZE 8
+
+typedef struct BudgieShadowEntry {
+        BudgieShadowKey key;
+        cairo_surface_t *surface;
+        guint64 age;
+} BudgieShadowEntry;
+
+struct BudgieShadowCache {
+        BudgieShadowSilhouetteFunc silhouette;
+        gpointer udata;
+        BudgieShadowEntry entries[BUDGIE_SHADOW_CACHE_SIZE];
+        guint64 clock;
+};
+
+/**
+ * budgie_shadow_cache_new:
+ * @silhouette: Function used to fill the shape being blurred
+ * @udata: User data for @silhouette
+ *
+ * Returns: (transfer full): A new shadow cache, freed with budgie_shadow_cache_free()
+ */
+BudgieShadowCache *budgie_shadow_cache_new(BudgieShadowSilhouetteFunc silhouette, gpointer udata)
+{
+        BudgieShadowCache *cache = NULL;
+
+        cache = g_new0(BudgieShadowCache, 1);
+        cache->silhouette = silhouette;
+        cache->udata = udata;
+        return cache;
+}
+
+/**
+ * budgie_shadow_cache_free:
+ *
+ * Free the cache and every mask it holds
+ */
+void budgie_shadow_cache_free(BudgieShadowCache *cache)
+{
+        if (!cache) {
+                return;
+        }
+        budgie_shadow_cache_invalidate(cache);
+        g_free(cache);
+}
+
+/**
+ * budgie_shadow_cache_invalidate:
+ *
+ * Drop every cached mask. Masks are keyed on the style serial, so this is
+ * only needed to give the memory back early.
+ */
+void budgie_shadow_cache_invalidate(BudgieShadowCache *cache)
+{
+        for (guint i = 0; i < BUDGIE_SHADOW_CACHE_SIZE; i++) {
+                g_clear_pointer(&cache->entries[i].surface, cairo_surface_destroy);
+        }
+}
+
+/**
+ * budgie_shadow_cache_get:
+ * @key: Zeroed and then filled key for the wanted shadow
+ *
+ * Find the blurred shadow mask for @key, rendering and blurring the
+ * silhouette only if it isn't already cached. The least recently used mask
+ * is evicted to make room.
+ *
+ * Returns: (transfer none): An A8 surface of the key's size
+ */
+cairo_surface_t *budgie_shadow_cache_get(BudgieShadowCache *cache, const BudgieShadowKey *key)
+{
+        BudgieShadowEntry *entry = NULL;
+        cairo_t *cr = NULL;
+
+        cache->clock++;
+
+        for (guint i = 0; i < BUDGIE_SHADOW_CACHE_SIZE; i++) {
+                BudgieShadowEntry *e = &cache->entries[i];
+
+                if (e->surface && memcmp(&e->key, key, sizeof(*key)) == 0) {
+                        e->age = cache->clock;
+                        return e->surface;
+                }
+                if (!entry || !e->surface || (entry->surface && e->age < entry->age)) {
+                        entry = e;
+                }
+        }
+
+        g_clear_pointer(&entry->surface, cairo_surface_destroy);
+        entry->key = *key;
+        entry->age = cache->clock;
+        entry->surface = cairo_image_surface_create(CAIRO_FORMAT_A8, key->width, key->height);
+
+        cr = cairo_create(entry->surface);
+        cairo_set_source_rgba(cr, 0, 0, 0, 1);
+        cache->silhouette(cr, key, cache->udata);
+        cairo_destroy(cr);
+
+        cairo_surface_flush(entry->surface);
+        budgie_shadow_blur(cairo_image_surface_get_data(entry->surface),
+                           cairo_image_surface_get_width(entry->surface),
+                           cairo_image_surface_get_height(entry->surface),
+                           cairo_image_surface_get_stride(entry->surface),
+                           key->radius);
+        cairo_surface_mark_dirty(entry->surface);
+
+        return entry->surface;
+}
+
+/**
+ * One horizontal box pass over a single row. The running sum makes this
+ * cost the same regardless of @radius. Pixels beyond the row are clear.
+ */
+static void budgie_shadow_box_row(const guint8 *src, guint8 *dst, gint width, gint radius,
+                                  guint32 mul)
+{
+        guint32 sum = 0;
+
+        for (gint x = 0; x < MIN(radius, width); x++) {
+                sum += src[x];
+        }
+
+        for (gint x = 0; x < width; x++) {
+                if (x + radius < width) {
+                        sum += src[x + radius];
+                }
+                dst[x] = (guint8)((sum * mul + 0x8000) >> 16);
+                if (x - radius >= 0) {
+                        sum -= src[x - radius];
+                }
+        }
+}
+
+/**
+ * One vertical box pass over the whole image. This walks rows rather than
+ * columns, keeping one running sum per column, so every inner loop is a
+ * straight run over contiguous memory that the compiler can vectorise.
+ */
+static void budgie_shadow_box_columns(const guint8 *src, guint8 *dst, gint width, gint height,
+                                      gint stride, gint radius, guint32 mul, guint32 *sums)
+{
+        memset(sums, 0, sizeof(guint32) * (gsize)width);
+
+        for (gint y = 0; y < MIN(radius, height); y++) {
+                const guint8 *row = src + (gsize)y * (gsize)stride;
+
+                for (gint x = 0; x < width; x++) {
+                        sums[x] += row[x];
+                }
+        }
+
+        for (gint y = 0; y < height; y++) {
+                guint8 *out = dst + (gsize)y * (gsize)stride;
+
+                if (y + radius < height) {
+                        const guint8 *in = src + (gsize)(y + radius) * (gsize)stride;
+
+                        for (gint x = 0; x < width; x++) {
+                                sums[x] += in[x];
+                        }
+                }
+                for (gint x = 0; x < width; x++) {
+                        out[x] = (guint8)((sums[x] * mul + 0x8000) >> 16);
+                }
+                if (y - radius >= 0) {
+                        const guint8 *in = src + (gsize)(y - radius) * (gsize)stride;
+
+                        for (gint x = 0; x < width; x++) {
+                                sums[x] -= in[x];
+                        }
+                }
+        }
+}
+
+/**
+ * budgie_shadow_blur:
+ * @pixels: 8-bit alpha pixels, blurred in place
+ * @width: Width of @pixels
+ * @height: Height of @pixels
+ * @stride: Bytes between the start of each row
+ * @radius: Box radius of each pass
+ *
+ * Approximate a gaussian blur with three separable box blurs in each
+ * direction, which come within a few percent of the real thing. The cost per
+ * pixel is independent of @radius, and the result extends by at most
+ * 3 * @radius beyond the original shape.
+ */
+void budgie_shadow_blur(guint8 *pixels, gint width, gint height, gint stride, gint radius)
+{
+        guint8 *scratch = NULL;
+        guint8 *line = NULL;
+        guint32 *sums = NULL;
+        guint32 mul = 0;
+        gsize size = (gsize)stride * (gsize)height;
+
+        if (radius < 1 || width < 1 || height < 1) {
+                return;
+        }
+
+        /* Divide by the window size with a multiply and a shift */
+        mul = (1u << 16) / (guint32)((radius * 2) + 1);
+
+        line = g_malloc((gsize)width * 2);
+        for (gint y = 0; y < height; y++) {
+                guint8 *row = pixels + (gsize)y * (gsize)stride;
+
+                budgie_shadow_box_row(row, line, width, radius, mul);
+                budgie_shadow_box_row(line, line + width, width, radius, mul);
+                budgie_shadow_box_row(line + width, row, width, radius, mul);
+        }
+        g_free(line);
+
+        scratch = g_malloc(size);
+        sums = g_new(guint32, width);
+        budgie_shadow_box_columns(pixels, scratch, width, height, stride, radius, mul, sums);
+        budgie_shadow_box_columns(scratch, pixels, width, height, stride, radius, mul, sums);
+        budgie_shadow_box_columns(pixels, scratch, width, height, stride, radius, mul, sums);
+        memcpy(pixels, scratch, size);
+        g_free(sums);
+        g_free(scratch);
+}
+
+/*
+ * Editor modelines  -  https://www.wireshark.org/tools/modelines.html
+ *
+ * Local variables:
+ * c-basic-offset: 8
+ * tab-width: 8
+ * indent-tabs-mode: nil
+ * End:
+ *
+ * vi: set shiftwidth=8 tabstop=8 expandtab:
+ * :indentSize=8:tabSize=8:noTabs=true:
+ */
@@ -0,0 +1,60 @@
+/*
+ * This file is part of ui-tests
+ *
+ * Copyright © 2016-2017 Ikey Doherty <ikey@solus-project.com>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ */
+
+#pragma once
+
+#include <gtk/gtk.h>
+
+G_BEGIN_DECLS
+
+typedef struct BudgieShadowCache BudgieShadowCache;
+
+/**
+ * Everything that determines the blurred shadow mask for a popover
+ */
+typedef struct BudgieShadowKey {
+        gint width;
+        gint height;
+        GtkPositionType position;
+        double x_offset;
+        double y_offset;
+        gint radius;
+        guint style_serial;
+} BudgieShadowKey;
+
+/**
+ * Fill the silhouette (body and tail) of a popover of the keyed size into
+ * @cr, in opaque. It will be blurred afterwards to form the shadow.
+ */
+typedef void (*BudgieShadowSilhouetteFunc)(cairo_t *cr, const BudgieShadowKey *key,
+                                           gpointer udata);
+
+BudgieShadowCache *budgie_shadow_cache_new(BudgieShadowSilhouetteFunc silhouette, gpointer udata);
+void budgie_shadow_cache_free(BudgieShadowCache *cache);
+void budgie_shadow_cache_invalidate(BudgieShadowCache *cache);
+cairo_surface_t *budgie_shadow_cache_get(BudgieShadowCache *cache, const BudgieShadowKey *key);
+
+void budgie_shadow_blur(guint8 *pixels, gint width, gint height, gint stride, gint radius);
+
+G_END_DECLS
+
+/*
+ * Editor modelines  -  https://www.wireshark.org/tools/modelines.html
+ *
+ * Local variables:
+ * c-basic-offset: 8
+ * tab-width: 8
+ * indent-tabs-mode: nil
+ * End:
+ *
+ * vi: set shiftwidth=8 tabstop=8 expandtab:
+ * :indentSize=8:tabSize=8:noTabs=true:
+ */
@@ -0,0 +1,163 @@
+/*
+ * This file is part of ui-tests
+ *
+ * Copyright © 2016-2017 Ikey Doherty <ikey@solus-project.com>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ */
+
+#define _GNU_SOURCE
+
+#include "util.h"
+
+BUDGIE_BEGIN_PEDANTIC
+#include "popover-stats.h"
+#include <string.h>
+BUDGIE_END_PEDANTIC
+
+static const gchar *histogram_names[BUDGIE_STATS_N_HISTOGRAMS] = {
+        [BUDGIE_STATS_SHOW] = "show",         [BUDGIE_STATS_PLACEMENT] = "placement",
+        [BUDGIE_STATS_DRAW] = "draw",         [BUDGIE_STATS_GRAB] = "grab",
+        [BUDGIE_STATS_UNGRAB] = "ungrab",     [BUDGIE_STATS_ROLLOVER] = "rollover",
+};
+
+static const gchar *counter_names[BUDGIE_STATS_N_COUNTERS] = {
+        [BUDGIE_STATS_OPENS] = "opens",
+        [BUDGIE_STATS_WARM_OPENS] = "warm_opens",
+        [BUDGIE_STATS_COLD_OPENS] = "cold_opens",
+        [BUDGIE_STATS_PLACEMENT_HITS] = "placement_hits",
+        [BUDGIE_STATS_PLACEMENT_MISSES] = "placement_misses",
+        [BUDGIE_STATS_CHROME_HITS] = "chrome_hits",
+        [BUDGIE_STATS_CHROME_MISSES] = "chrome_misses",
+        [BUDGIE_STATS_REDRAWS] = "redraws",
+        [BUDGIE_STATS_PIXELS] = "pixels",
+        [BUDGIE_STATS_GEOMETRY_QUERIES] = "geometry_queries",
+        [BUDGIE_STATS_SPECULATIONS] = "speculations",
+        [BUDGIE_STATS_SPECULATION_HITS] = "speculation_hits",
+        [BUDGIE_STATS_SPECULATION_MISSES] = "speculation_misses",
+        [BUDGIE_STATS_SPECULATIONS_CAPPED] = "speculations_capped",
+        [BUDGIE_STATS_ROLLOVERS] = "rollovers",
+        [BUDGIE_STATS_SHOW_REQUESTS] = "show_requests",
+        [BUDGIE_STATS_SHOW_DISPATCHES] = "show_dispatches",
+};
+
+/**
+ * budgie_stats_reset:
+ *
+ * Zero every histogram and counter
+ */
+void budgie_stats_reset(BudgieStats *stats)
+{
+        memset(stats, 0, sizeof(*stats));
+}
+
+/**
+ * budgie_stats_record:
+ * @histogram: Histogram to record into
+ * @usec: Duration of the sample in microseconds
+ *
+ * Record a single timing sample. This never allocates.
+ */
+void budgie_stats_record(BudgieStats *stats, BudgieStatsHistogram histogram, gint64 usec)
+{
+        BudgieHistogram *h = &(stats->histograms[histogram]);
+        guint bucket = 0;
+
+        if (usec > 0) {
+                bucket = MIN(g_bit_storage((gulong)usec), BUDGIE_STATS_N_BUCKETS - 1);
+        } else {
+                usec = 0;
+        }
+
+        h->buckets[bucket]++;
+        h->count++;
+        h->total += usec;
+        h->max = MAX(h->max, usec);
+}
+
+/**
+ * budgie_stats_merge:
+ * @other: Statistics to add into @stats
+ *
+ * Accumulate @other into @stats, i.e. to total up several popovers
+ */
+void budgie_stats_merge(BudgieStats *stats, const BudgieStats *other)
+{
+        for (guint i = 0; i < BUDGIE_STATS_N_HISTOGRAMS; i++) {
+                BudgieHistogram *h = &(stats->histograms[i]);
+                const BudgieHistogram *o = &(other->histograms[i]);
+
+                for (guint b = 0; b < BUDGIE_STATS_N_BUCKETS; b++) {
+                        h->buckets[b] += o->buckets[b];
+                }
+                h->count += o->count;
+                h->total += o->total;
+                h->max = MAX(h->max, o->max);
+        }
+
+        for (guint i = 0; i < BUDGIE_STATS_N_COUNTERS; i++) {
+                stats->counters[i] += other->counters[i];
+        }
+}
+
+/**
+ * budgie_stats_to_json:
+ *
+ * Serialise @stats as a JSON object for offline inspection
+ *
+ * Returns: (transfer full): A newly allocated JSON string
+ */
+gchar *budgie_stats_to_json(const BudgieStats *stats)
+{
+        GString *json = g_string_new("{\n  \"counters\": {");
+
+        for (guint i = 0; i < BUDGIE_STATS_N_COUNTERS; i++) {
+                g_string_append_printf(json,
+                                       "%s\n    \"%s\": %" G_GUINT64_FORMAT,
+                                       i > 0 ? "," : "",
+                                       counter_names[i],
+                                       stats->counters[i]);
+        }
+
+        g_string_append(json, "\n  },\n  \"histograms\": {");
+
+        for (guint i = 0; i < BUDGIE_STATS_N_HISTOGRAMS; i++) {
+                const BudgieHistogram *h = &(stats->histograms[i]);
+
+                g_string_append_printf(json,
+                                       "%s\n    \"%s\": { \"count\": %" G_GUINT64_FORMAT
+                                       ", \"total_us\": %" G_GINT64_FORMAT
+                                       ", \"max_us\": %" G_GINT64_FORMAT ", \"buckets\": [",
+                                       i > 0 ? "," : "",
+                                       histogram_names[i],
+                                       h->count,
+                                       h->total,
+                                       h->max);
+                for (guint b = 0; b < BUDGIE_STATS_N_BUCKETS; b++) {
+                        g_string_append_printf(json,
+                                               "%s%" G_GUINT64_FORMAT,
+                                               b > 0 ? ", " : "",
+                                               h->buckets[b]);
+                }
+                g_string_append(json, "] }");
+        }
+
+        g_string_append(json, "\n  }\n}\n");
+        return g_string_free(json, FALSE);
+}
+
+/*
+ * Editor modelines  -  https://www.wireshark.org/tools/modelines.html
+ *
+ * Local variables:
+ * c-basic-offset: 8
+ * tab-width: 8
+ * indent-tabs-mode: nil
+ * End:
+ *
+ * vi: set shiftwidth=8 tabstop=8 expandtab:
+ * :indentSize=8:tabSize=8:noTabs=true:
+ */
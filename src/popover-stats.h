@@ -0,0 +1,107 @@
+/*
+ * This file is part of ui-tests
+ *
+ * Copyright © 2016-2017 Ikey Doherty <ikey@solus-project.com>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ */
+
+#pragma once
+
+#include <glib.h>
+
+G_BEGIN_DECLS
+
+/**
+ * Performance statistics for popovers and the manager. Recording is a
+ * handful of integer operations into fixed-size arrays, so it is cheap
+ * enough to leave enabled at all times.
+ */
+
+/**
+ * Bucket i of a histogram counts samples in [2^(i-1), 2^i) microseconds, with
+ * bucket 0 holding zero-length samples and the last bucket everything longer.
+ */
+#define BUDGIE_STATS_N_BUCKETS 24
+
+typedef enum {
+        BUDGIE_STATS_SHOW = 0,  /* Show request to first draw */
+        BUDGIE_STATS_PLACEMENT, /* Placement computation */
+        BUDGIE_STATS_DRAW,      /* Time spent in draw */
+        BUDGIE_STATS_GRAB,      /* Seat grab acquisition */
+        BUDGIE_STATS_UNGRAB,    /* Seat grab release */
+        BUDGIE_STATS_ROLLOVER,  /* Enter event to first frame of the new popover */
+        BUDGIE_STATS_N_HISTOGRAMS,
+} BudgieStatsHistogram;
+
+typedef enum {
+        BUDGIE_STATS_OPENS = 0,
+        BUDGIE_STATS_WARM_OPENS,
+        BUDGIE_STATS_COLD_OPENS,
+        BUDGIE_STATS_PLACEMENT_HITS,
+        BUDGIE_STATS_PLACEMENT_MISSES,
+        BUDGIE_STATS_CHROME_HITS,
+        BUDGIE_STATS_CHROME_MISSES,
+        BUDGIE_STATS_REDRAWS,
+        BUDGIE_STATS_PIXELS, /* Pixels repainted, per the clip of each draw */
+        BUDGIE_STATS_GEOMETRY_QUERIES, /* Hit tests that had to ask the display server */
+        BUDGIE_STATS_SPECULATIONS, /* Placements worked out on hover */
+        BUDGIE_STATS_SPECULATION_HITS, /* Opens that found their speculation still valid */
+        BUDGIE_STATS_SPECULATION_MISSES, /* Opens that had to throw their speculation away */
+        BUDGIE_STATS_SPECULATIONS_CAPPED, /* Hovers dropped by the rate limit */
+        BUDGIE_STATS_ROLLOVERS,           /* Roll-overs started, finished or not */
+        BUDGIE_STATS_SHOW_REQUESTS,       /* Times a popover was asked to show */
+        BUDGIE_STATS_SHOW_DISPATCHES,     /* Main loop dispatches spent showing them */
+        BUDGIE_STATS_N_COUNTERS,
+} BudgieStatsCounter;
+
+typedef struct BudgieHistogram {
+        guint64 buckets[BUDGIE_STATS_N_BUCKETS];
+        guint64 count;
+        gint64 total;
+        gint64 max;
+} BudgieHistogram;
+
+typedef struct BudgieStats {
+        BudgieHistogram histograms[BUDGIE_STATS_N_HISTOGRAMS];
+        guint64 counters[BUDGIE_STATS_N_COUNTERS];
+} BudgieStats;
+
+void budgie_stats_reset(BudgieStats *stats);
+void budgie_stats_record(BudgieStats *stats, BudgieStatsHistogram histogram, gint64 usec);
+void budgie_stats_merge(BudgieStats *stats, const BudgieStats *other);
+gchar *budgie_stats_to_json(const BudgieStats *stats);
+
+/**
+ * Bump one of the counters
+ */
+static inline void budgie_stats_count(BudgieStats *stats, BudgieStatsCounter counter)
+{
+        stats->counters[counter]++;
+}
+
+/**
+ * Add @n to one of the counters
+ */
+static inline void budgie_stats_add(BudgieStats *stats, BudgieStatsCounter counter, guint64 n)
+{
+        stats->counters[counter] += n;
+}
+
+G_END_DECLS
+
+/*
+ * Editor modelines  -  https://www.wireshark.org/tools/modelines.html
+ *
+ * Local variables:
+ * c-basic-offset: 8
+ * tab-width: 8
+ * indent-tabs-mode: nil
+ * End:
+ *
+ * vi: set shiftwidth=8 tabstop=8 expandtab:
+ * :indentSize=8:tabSize=8:noTabs=true:
+ */
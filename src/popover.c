@@ -12,45 +12,104 @@
 #define _GNU_SOURCE
 
 #include "util.h"
+#include <string.h>
 
 BUDGIE_BEGIN_PEDANTIC
 #include "budgie-enums.h"
+#include "geometry-cache.h"
+#include "monitor-cache.h"
+#include "popover-chrome.h"
+#include "popover-placement.h"
+#include "popover-private.h"
+#include "popover-shadow.h"
 #include "popover.h"
 #include <gtk/gtk.h>
 BUDGIE_END_PEDANTIC
 
 /**
- * We'll likely take this from a style property in future, but for now it
- * is both the width and height of a tail
+ * Defaults for the tail-dimension and shadow-dimension style properties.
+ * The tail dimension is both the width and height of a tail.
  */
 #define TAIL_DIMENSION 16
-#define TAIL_HEIGHT TAIL_DIMENSION / 2
 #define SHADOW_DIMENSION 4
 
 /**
- * Used for storing BudgieTail calculations
+ * The shadow is dropped this far below the body, and the blur fills the rest
+ * of the shadow dimension
  */
-typedef struct BudgieTail {
-        double start_x;
-        double start_y;
-        double end_x;
-        double end_y;
-        double x;
-        double y;
+#define SHADOW_OFFSET 1
+#define SHADOW_OPACITY 0.55
+
+/* Placement edges are passed straight through to GTK */
+G_STATIC_ASSERT((gint)BUDGIE_PLACEMENT_EDGE_LEFT == (gint)GTK_POS_LEFT);
+G_STATIC_ASSERT((gint)BUDGIE_PLACEMENT_EDGE_RIGHT == (gint)GTK_POS_RIGHT);
+G_STATIC_ASSERT((gint)BUDGIE_PLACEMENT_EDGE_TOP == (gint)GTK_POS_TOP);
+G_STATIC_ASSERT((gint)BUDGIE_PLACEMENT_EDGE_BOTTOM == (gint)GTK_POS_BOTTOM);
+
+/**
+ * The chrome (background, frame and tail) is rendered once into a surface
+ * and reused until any of these parameters change.
+ */
+typedef struct BudgieChromeKey {
+        gint width;
+        gint height;
+        BudgiePlacementEdge position;
         double x_offset;
         double y_offset;
-        GtkPositionType position;
-} BudgieTail;
+        guint style_serial;
+} BudgieChromeKey;
+
+/**
+ * Style derived values used on the hot paths. These are refreshed only when
+ * our style, or the style of the toplevel hosting relative_to, changes.
+ */
+typedef struct BudgieStyleMetrics {
+        GdkRGBA border_color;
+        gint border_radius;
+        gint tail_dimension;
+        gint shadow_dimension;
+        BudgiePlacementEdge toplevel_edge;
+} BudgieStyleMetrics;
 
 struct _BudgiePopoverPrivate {
         GtkWidget *add_area;
         GtkWidget *relative_to;
         BudgieTail tail;
+        BudgiePlacement placement;
+        gboolean placement_valid;
+        BudgiePlacementMemo placement_memo;
         BudgiePopoverPositionPolicy policy;
         gboolean grabbed;
+        gboolean managed_grab; /* Seat grab is owned by a BudgiePopoverManager */
+        BudgiePopoverManager *manager; /* Told about our state changes, unowned */
+        cairo_surface_t *chrome;
+        BudgieChromeKey chrome_key;
+        BudgieChromeSlices *slices;
+        guint slices_serial;
+        BudgieShadowCache *shadow;
+        guint style_serial;
+        BudgieStyleMetrics metrics;
+        guint metrics_serial;
+        GtkWidget *hint_toplevel;
+        gulong hint_toplevel_id;
+        gulong screen_id; /* composited-changed, only while unmanaged */
+        gboolean toplevel_edge_valid;
+        BudgieStats stats;
+        gint64 show_start; /* Time of the last show, until the first draw */
+        gint64 show_requested; /* When our manager was asked for the next show */
+        GdkRectangle screen_rect; /* From our placement and configure-event */
+        gboolean screen_rect_valid;
+        cairo_region_t *input_shape; /* Body and tail, relative to our window */
+        BudgieChromeKey shape_key;
+        BudgiePopoverRenderMode render_mode;
+        guint visual_source; /* Pending unrealize to pick up a new visual */
+        gboolean shaped; /* Window itself is shaped, not just its input */
+        GtkBorder shadow_width; /* Last frame extents given to the compositor */
+        BudgiePlacement speculation; /* Placement worked out ahead of the next show */
+        gboolean speculated;
 };
 
-enum { PROP_RELATIVE_TO = 1, PROP_POLICY, N_PROPS };
+enum { PROP_RELATIVE_TO = 1, PROP_POLICY, PROP_RENDER_MODE, N_PROPS };
 
 static GParamSpec *obj_properties[N_PROPS] = {
         NULL,
@@ -59,23 +118,47 @@ static GParamSpec *obj_properties[N_PROPS] = {
 G_DEFINE_TYPE_WITH_PRIVATE(BudgiePopover, budgie_popover, GTK_TYPE_WINDOW)
 
 static gboolean budgie_popover_draw(GtkWidget *widget, cairo_t *cr);
+static void budgie_popover_show(GtkWidget *widget);
+static void budgie_popover_style_updated(GtkWidget *widget);
+static void budgie_popover_realize(GtkWidget *widget);
+static void budgie_popover_unrealize(GtkWidget *widget);
+static void budgie_popover_destroy(GtkWidget *widget);
 static void budgie_popover_map(GtkWidget *widget);
 static void budgie_popover_unmap(GtkWidget *widget);
+static gboolean budgie_popover_map_event(GtkWidget *widget, GdkEventAny *event);
+static gboolean budgie_popover_unmap_event(GtkWidget *widget, GdkEventAny *event);
+static gboolean budgie_popover_configure_event(GtkWidget *widget, GdkEventConfigure *event);
 static void budgie_popover_size_allocate(GtkWidget *widget, GtkAllocation *alloc);
-static void budgie_popover_grab_notify(GtkWidget *widget, gboolean was_grabbed, gpointer udata);
-static gboolean budgie_popover_grab_broken(GtkWidget *widget, GdkEvent *event, gpointer udata);
+static void budgie_popover_grab_notify(GtkWidget *widget, gboolean was_grabbed);
+static gboolean budgie_popover_grab_broken(GtkWidget *widget, GdkEventGrabBroken *event);
 static void budgie_popover_grab(BudgiePopover *self);
 static void budgie_popover_ungrab(BudgiePopover *self);
 static void budgie_popover_add(GtkContainer *container, GtkWidget *widget);
-static gboolean budgie_popover_button_press(GtkWidget *widget, GdkEventButton *button,
-                                            gpointer udata);
-static gboolean budgie_popover_key_press(GtkWidget *widget, GdkEventKey *key, gpointer udata);
+static gboolean budgie_popover_button_press(GtkWidget *widget, GdkEventButton *button);
+static gboolean budgie_popover_key_press(GtkWidget *widget, GdkEventKey *key);
 static void budgie_popover_set_property(GObject *object, guint id, const GValue *value,
                                         GParamSpec *spec);
 static void budgie_popover_get_property(GObject *object, guint id, GValue *value, GParamSpec *spec);
-static void budgie_popover_compute_positition(BudgiePopover *self, GdkRectangle *target);
+static void budgie_popover_compute_positition(BudgiePopover *self, BudgiePlacement *placement);
+static gboolean budgie_popover_apply_placement(BudgiePopover *self, BudgiePlacement *placement);
+static void budgie_popover_tail_for_allocation(BudgiePopover *self, BudgiePlacementEdge position,
+                                               GtkAllocation *alloc, BudgieTail *tail);
+static const BudgieStyleMetrics *budgie_popover_get_metrics(BudgiePopover *self);
+static void budgie_popover_watch_toplevel(BudgiePopover *self, GtkWidget *toplevel);
+static void budgie_popover_watch_screen(BudgiePopover *self, gboolean watch);
 static void budgie_popover_compute_widget_geometry(GtkWidget *parent_widget, GdkRectangle *target);
 static void budgie_popover_compute_tail(BudgiePopover *self);
+static void budgie_popover_damage_tail(BudgiePopover *self, BudgieTail *tail);
+static void budgie_popover_update_input_shape(BudgiePopover *self);
+static void budgie_popover_update_render_mode(BudgiePopover *self);
+static gboolean budgie_popover_swap_visual(gpointer v);
+static void budgie_popover_damage_resize(BudgiePopover *self, GtkAllocation *old,
+                                         GtkAllocation *alloc, gboolean moved);
+static void budgie_popover_render_template(cairo_t *cr, GtkPositionType position,
+                                           GtkAllocation *alloc, gpointer udata);
+static void budgie_popover_render_silhouette(cairo_t *cr, const BudgieShadowKey *key,
+                                             gpointer udata);
+static void budgie_popover_check_speculation(BudgiePopover *self, BudgiePlacement *placement);
 
 /**
  * budgie_popover_dispose:
@@ -84,6 +167,24 @@ static void budgie_popover_compute_tail(BudgiePopover *self);
  */
 static void budgie_popover_dispose(GObject *obj)
 {
+        BudgiePopover *self = BUDGIE_POPOVER(obj);
+
+        budgie_popover_watch_toplevel(self, NULL);
+        if (self->priv->relative_to) {
+                g_signal_handlers_disconnect_by_data(self->priv->relative_to, self);
+                budgie_geometry_cache_untrack(self->priv->relative_to);
+                self->priv->relative_to = NULL;
+        }
+        g_clear_pointer(&self->priv->chrome, cairo_surface_destroy);
+        g_clear_pointer(&self->priv->slices, budgie_chrome_slices_free);
+        g_clear_pointer(&self->priv->shadow, budgie_shadow_cache_free);
+        g_clear_pointer(&self->priv->input_shape, cairo_region_destroy);
+        g_signal_handlers_disconnect_by_data(gtk_widget_get_screen(GTK_WIDGET(self)), self);
+        if (self->priv->visual_source > 0) {
+                g_source_remove(self->priv->visual_source);
+                self->priv->visual_source = 0;
+        }
+
         G_OBJECT_CLASS(budgie_popover_parent_class)->dispose(obj);
 }
 
@@ -106,8 +207,20 @@ static void budgie_popover_class_init(BudgiePopoverClass *klazz)
         /* widget vtable hookup */
         wid_class->size_allocate = budgie_popover_size_allocate;
         wid_class->draw = budgie_popover_draw;
+        wid_class->show = budgie_popover_show;
+        wid_class->style_updated = budgie_popover_style_updated;
+        wid_class->realize = budgie_popover_realize;
+        wid_class->unrealize = budgie_popover_unrealize;
+        wid_class->destroy = budgie_popover_destroy;
         wid_class->map = budgie_popover_map;
         wid_class->unmap = budgie_popover_unmap;
+        wid_class->map_event = budgie_popover_map_event;
+        wid_class->unmap_event = budgie_popover_unmap_event;
+        wid_class->configure_event = budgie_popover_configure_event;
+        wid_class->grab_notify = budgie_popover_grab_notify;
+        wid_class->grab_broken_event = budgie_popover_grab_broken;
+        wid_class->button_press_event = budgie_popover_button_press;
+        wid_class->key_press_event = budgie_popover_key_press;
 
         /* container vtable */
         cont_class->add = budgie_popover_add;
@@ -135,7 +248,48 @@ static void budgie_popover_class_init(BudgiePopoverClass *klazz)
                                                         BUDGIE_POPOVER_POSITION_AUTOMATIC,
                                                         G_PARAM_READWRITE);
 
+        /**
+         * BudgiePopover:render-mode:
+         *
+         * How the popover is currently being rendered, which depends on
+         * whether the screen is composited.
+         */
+        obj_properties[PROP_RENDER_MODE] = g_param_spec_enum("render-mode",
+                                                             "Render mode",
+                                                             "Get the active render mode",
+                                                             BUDGIE_TYPE_POPOVER_RENDER_MODE,
+                                                             BUDGIE_POPOVER_RENDER_COMPOSITED,
+                                                             G_PARAM_READABLE);
+
         g_object_class_install_properties(obj_class, N_PROPS, obj_properties);
+
+        /**
+         * BudgiePopover:tail-dimension:
+         *
+         * Width and height of the tail pointing at the relative widget
+         */
+        gtk_widget_class_install_style_property(wid_class,
+                                                g_param_spec_int("tail-dimension",
+                                                                 "Tail dimension",
+                                                                 "Size of the popover tail",
+                                                                 0,
+                                                                 G_MAXINT16,
+                                                                 TAIL_DIMENSION,
+                                                                 G_PARAM_READABLE));
+
+        /**
+         * BudgiePopover:shadow-dimension:
+         *
+         * Space reserved around the popover body for the shadow
+         */
+        gtk_widget_class_install_style_property(wid_class,
+                                                g_param_spec_int("shadow-dimension",
+                                                                 "Shadow dimension",
+                                                                 "Size of the popover shadow",
+                                                                 0,
+                                                                 G_MAXINT16,
+                                                                 SHADOW_DIMENSION,
+                                                                 G_PARAM_READABLE));
 }
 
 /**
@@ -146,12 +300,13 @@ static void budgie_popover_class_init(BudgiePopoverClass *klazz)
 static void budgie_popover_init(BudgiePopover *self)
 {
         GtkWindow *win = GTK_WINDOW(self);
-        GdkScreen *screen = NULL;
-        GdkVisual *visual = NULL;
         GtkStyleContext *style = NULL;
 
         self->priv = budgie_popover_get_instance_private(self);
         self->priv->grabbed = FALSE;
+        self->priv->style_serial = 1;
+        self->priv->slices = budgie_chrome_slices_new(budgie_popover_render_template, self);
+        self->priv->shadow = budgie_shadow_cache_new(budgie_popover_render_silhouette, self);
 
         style = gtk_widget_get_style_context(GTK_WIDGET(self));
         gtk_style_context_add_class(style, "budgie-popover");
@@ -161,28 +316,27 @@ static void budgie_popover_init(BudgiePopover *self)
         gtk_window_set_wmclass(GTK_WINDOW(self), "budgie-popover", "budgie-popover");
         G_GNUC_END_IGNORE_DEPRECATIONS
 
+        /* We work out our own damage on resize, see budgie_popover_damage_resize() */
+        gtk_widget_set_redraw_on_allocate(GTK_WIDGET(self), FALSE);
+
         self->priv->add_area = gtk_event_box_new();
         gtk_container_add(GTK_CONTAINER(self), self->priv->add_area);
         gtk_widget_show_all(self->priv->add_area);
 
         /* Setup window specific bits */
         gtk_window_set_position(win, GTK_WIN_POS_CENTER);
-        g_signal_connect(win, "grab-notify", G_CALLBACK(budgie_popover_grab_notify), NULL);
-        g_signal_connect(win, "grab-broken-event", G_CALLBACK(budgie_popover_grab_broken), NULL);
-        g_signal_connect(win, "button-press-event", G_CALLBACK(budgie_popover_button_press), NULL);
-        g_signal_connect(win, "key-press-event", G_CALLBACK(budgie_popover_key_press), NULL);
 
-        /* Set up RGBA ability */
-        screen = gtk_widget_get_screen(GTK_WIDGET(self));
-        visual = gdk_screen_get_rgba_visual(screen);
-        if (visual) {
-                gtk_widget_set_visual(GTK_WIDGET(self), visual);
-        }
+        /* Set up RGBA ability, and follow the compositor coming and going until
+         * a manager takes over telling us about it */
+        budgie_popover_update_render_mode(self);
+        budgie_popover_watch_screen(self, TRUE);
+
         /* We do all rendering */
         gtk_widget_set_app_paintable(GTK_WIDGET(self), TRUE);
 
         /* Set initial placement up for default bottom position */
-        self->priv->tail.position = GTK_POS_BOTTOM;
+        self->priv->tail.position = BUDGIE_PLACEMENT_EDGE_BOTTOM;
+        self->priv->placement_valid = FALSE;
 
         g_object_set(self->priv->add_area,
                      "margin-top",
@@ -199,33 +353,179 @@ static void budgie_popover_init(BudgiePopover *self)
 static void budgie_popover_map(GtkWidget *widget)
 {
         GdkWindow *window = NULL;
-        GdkRectangle coords = { 0 };
+        BudgiePlacement placement = { 0 };
         BudgiePopover *self = NULL;
 
         self = BUDGIE_POPOVER(widget);
+        budgie_stats_count(&self->priv->stats, BUDGIE_STATS_OPENS);
 
         /* Work out where we go on screen now */
-        budgie_popover_compute_positition(self, &coords);
-        gtk_widget_queue_draw(widget);
+        budgie_popover_compute_positition(self, &placement);
+        budgie_popover_check_speculation(self, &placement);
+        budgie_popover_apply_placement(self, &placement);
+        budgie_popover_update_input_shape(self);
 
         /* Forcibly request focus */
         window = gtk_widget_get_window(widget);
         gdk_window_set_accept_focus(window, TRUE);
         gdk_window_focus(window, GDK_CURRENT_TIME);
-        gdk_window_move(window, coords.x, coords.y);
+        gdk_window_move(window, placement.x, placement.y);
         gtk_window_present(GTK_WINDOW(widget));
 
-        budgie_popover_grab(BUDGIE_POPOVER(widget));
-        budgie_popover_ungrab(BUDGIE_POPOVER(widget));
+        self->priv->screen_rect.x = placement.x;
+        self->priv->screen_rect.y = placement.y;
+        gtk_window_get_size(GTK_WINDOW(widget),
+                            &self->priv->screen_rect.width,
+                            &self->priv->screen_rect.height);
+        self->priv->screen_rect_valid = TRUE;
+
         budgie_popover_grab(BUDGIE_POPOVER(widget));
 
         GTK_WIDGET_CLASS(budgie_popover_parent_class)->map(widget);
 }
 
+/**
+ * Start the clock on the show latency, which stops at our first draw. When
+ * our manager queued the show, the clock started with its request.
+ */
+static void budgie_popover_show(GtkWidget *widget)
+{
+        BudgiePopover *self = BUDGIE_POPOVER(widget);
+
+        if (!gtk_widget_get_visible(widget)) {
+                self->priv->show_start = self->priv->show_requested > 0
+                                             ? self->priv->show_requested
+                                             : g_get_monotonic_time();
+        }
+        self->priv->show_requested = 0;
+        GTK_WIDGET_CLASS(budgie_popover_parent_class)->show(widget);
+}
+
+/**
+ * Our manager must forget us before anything can reference us again
+ */
+static void budgie_popover_destroy(GtkWidget *widget)
+{
+        BudgiePopover *self = BUDGIE_POPOVER(widget);
+
+        if (self->priv->manager) {
+                budgie_popover_manager_popover_died(self->priv->manager, self);
+        }
+        GTK_WIDGET_CLASS(budgie_popover_parent_class)->destroy(widget);
+}
+
+static gboolean budgie_popover_map_event(GtkWidget *widget, GdkEventAny *event)
+{
+        BudgiePopover *self = BUDGIE_POPOVER(widget);
+        GtkWidgetClass *parent_class = GTK_WIDGET_CLASS(budgie_popover_parent_class);
+
+        if (self->priv->manager) {
+                budgie_popover_manager_popover_mapped(self->priv->manager, self);
+        }
+        if (parent_class->map_event) {
+                return parent_class->map_event(widget, event);
+        }
+        return GDK_EVENT_PROPAGATE;
+}
+
+static gboolean budgie_popover_unmap_event(GtkWidget *widget, GdkEventAny *event)
+{
+        BudgiePopover *self = BUDGIE_POPOVER(widget);
+        GtkWidgetClass *parent_class = GTK_WIDGET_CLASS(budgie_popover_parent_class);
+
+        if (self->priv->manager) {
+                budgie_popover_manager_popover_unmapped(self->priv->manager, self);
+        }
+        if (parent_class->unmap_event) {
+                return parent_class->unmap_event(widget, event);
+        }
+        return GDK_EVENT_PROPAGATE;
+}
+
 static void budgie_popover_unmap(GtkWidget *widget)
 {
+        BUDGIE_POPOVER(widget)->priv->screen_rect_valid = FALSE;
         budgie_popover_ungrab(BUDGIE_POPOVER(widget));
         GTK_WIDGET_CLASS(budgie_popover_parent_class)->unmap(widget);
+
+        /* Any compositor change while we were up can be applied now */
+        budgie_popover_update_render_mode(BUDGIE_POPOVER(widget));
+}
+
+/**
+ * Our GdkWindow was made with the old visual, so drop it. This happens from
+ * idle rather than from within unmap, and our unrealize tells the manager,
+ * which then no longer counts us as warm.
+ */
+static gboolean budgie_popover_swap_visual(gpointer v)
+{
+        BudgiePopover *self = v;
+
+        self->priv->visual_source = 0;
+
+        /* Shown again in the meantime, so wait for the next unmap */
+        if (gtk_widget_get_mapped(GTK_WIDGET(self))) {
+                return G_SOURCE_REMOVE;
+        }
+        if (gtk_widget_get_realized(GTK_WIDGET(self))) {
+                gtk_widget_unrealize(GTK_WIDGET(self));
+        }
+        budgie_popover_update_render_mode(self);
+        return G_SOURCE_REMOVE;
+}
+
+/**
+ * Without a compositor (or an RGBA visual) translucency and shadows are
+ * wasted effort, so fall back to an opaque window shaped to the body and
+ * tail. The visual can only change while we're off screen, so a change
+ * while mapped is picked up again on unmap, and a realized window is only
+ * swapped out once we're back in the main loop.
+ */
+static void budgie_popover_update_render_mode(BudgiePopover *self)
+{
+        GtkWidget *widget = GTK_WIDGET(self);
+        GdkScreen *screen = gtk_widget_get_screen(widget);
+        GdkVisual *visual = NULL;
+        GtkStyleContext *style = NULL;
+        BudgiePopoverRenderMode mode = BUDGIE_POPOVER_RENDER_COMPOSITED;
+
+        if (gtk_widget_get_mapped(widget)) {
+                return;
+        }
+
+        visual = gdk_screen_get_rgba_visual(screen);
+        if (!visual || !gdk_screen_is_composited(screen)) {
+                visual = gdk_screen_get_system_visual(screen);
+                mode = BUDGIE_POPOVER_RENDER_OPAQUE;
+        }
+
+        if (gtk_widget_get_visual(widget) != visual) {
+                if (gtk_widget_get_realized(widget)) {
+                        if (self->priv->visual_source == 0) {
+                                self->priv->visual_source =
+                                    g_idle_add(budgie_popover_swap_visual, self);
+                        }
+                        return;
+                }
+                gtk_widget_set_visual(widget, visual);
+        }
+
+        if (mode == self->priv->render_mode) {
+                return;
+        }
+        self->priv->render_mode = mode;
+
+        /* Themes drop the shadow margin for .opaque */
+        style = gtk_widget_get_style_context(widget);
+        if (mode == BUDGIE_POPOVER_RENDER_OPAQUE) {
+                gtk_style_context_add_class(style, "opaque");
+        } else {
+                gtk_style_context_remove_class(style, "opaque");
+        }
+
+        /* Every cache depending on the metrics is now out of date */
+        self->priv->style_serial++;
+        g_object_notify_by_pspec(G_OBJECT(self), obj_properties[PROP_RENDER_MODE]);
 }
 
 /**
@@ -233,11 +533,15 @@ static void budgie_popover_unmap(GtkWidget *widget)
  */
 static void budgie_popover_size_allocate(GtkWidget *widget, GtkAllocation *allocation)
 {
+        GtkAllocation old = { 0 };
+
+        gtk_widget_get_allocation(widget, &old);
         GTK_WIDGET_CLASS(budgie_popover_parent_class)->size_allocate(widget, allocation);
 
         GdkWindow *window = NULL;
-        GdkRectangle coords = { 0 };
+        BudgiePlacement placement = { 0 };
         BudgiePopover *self = NULL;
+        gboolean moved = FALSE;
 
         self = BUDGIE_POPOVER(widget);
         window = gtk_widget_get_window(widget);
@@ -245,16 +549,42 @@ static void budgie_popover_size_allocate(GtkWidget *widget, GtkAllocation *alloc
                 return;
         }
 
-        /* Work out where we go on screen now */
-        budgie_popover_compute_positition(self, &coords);
+        /* Work out where we go on screen now, only moving if we need to */
+        budgie_popover_compute_positition(self, &placement);
+        moved = budgie_popover_apply_placement(self, &placement);
+        if (moved) {
+                gdk_window_move(window, placement.x, placement.y);
+                self->priv->screen_rect.x = placement.x;
+                self->priv->screen_rect.y = placement.y;
+        }
 
-        gdk_window_move(window, coords.x, coords.y);
+        budgie_popover_damage_resize(self, &old, allocation, moved);
+        self->priv->screen_rect.width = allocation->width;
+        self->priv->screen_rect.height = allocation->height;
+        budgie_popover_update_input_shape(self);
 }
 
 /**
- * Grab the input events using the GdkSeat
+ * The display server told us where we really ended up
  */
-static void budgie_popover_grab(BudgiePopover *self)
+static gboolean budgie_popover_configure_event(GtkWidget *widget, GdkEventConfigure *event)
+{
+        BudgiePopover *self = BUDGIE_POPOVER(widget);
+
+        self->priv->screen_rect = (GdkRectangle){.x = event->x,
+                                                 .y = event->y,
+                                                 .width = event->width,
+                                                 .height = event->height };
+        self->priv->screen_rect_valid = gtk_widget_get_mapped(widget);
+
+        return GTK_WIDGET_CLASS(budgie_popover_parent_class)->configure_event(widget, event);
+}
+
+/**
+ * Grab the input events using the GdkSeat. If the seat is already grabbed
+ * by us, this simply moves the grab to our window without an ungrab first.
+ */
+static gboolean budgie_popover_grab_seat(BudgiePopover *self)
 {
         GdkDisplay *display = NULL;
         GdkSeat *seat = NULL;
@@ -262,15 +592,11 @@ static void budgie_popover_grab(BudgiePopover *self)
         GdkSeatCapabilities caps = 0;
         GdkGrabStatus st;
 
-        if (self->priv->grabbed) {
-                return;
-        }
-
         window = gtk_widget_get_window(GTK_WIDGET(self));
 
         if (!window) {
                 g_warning("Attempting to grab BudgiePopover when not realized");
-                return;
+                return FALSE;
         }
 
         display = gtk_widget_get_display(GTK_WIDGET(self));
@@ -279,10 +605,24 @@ static void budgie_popover_grab(BudgiePopover *self)
         caps = GDK_SEAT_CAPABILITY_ALL;
 
         st = gdk_seat_grab(seat, window, caps, TRUE, NULL, NULL, NULL, NULL);
-        if (st == GDK_GRAB_SUCCESS) {
-                self->priv->grabbed = TRUE;
-                gtk_grab_add(GTK_WIDGET(self));
+        return st == GDK_GRAB_SUCCESS;
+}
+
+/**
+ * Grab the input events, leaving the seat alone when a manager owns it
+ */
+static void budgie_popover_grab(BudgiePopover *self)
+{
+        if (self->priv->grabbed) {
+                return;
         }
+
+        if (!self->priv->managed_grab && !budgie_popover_grab_seat(self)) {
+                return;
+        }
+
+        self->priv->grabbed = TRUE;
+        gtk_grab_add(GTK_WIDGET(self));
 }
 
 /**
@@ -297,24 +637,35 @@ static void budgie_popover_ungrab(BudgiePopover *self)
                 return;
         }
 
+        gtk_grab_remove(GTK_WIDGET(self));
+        self->priv->grabbed = FALSE;
+
+        if (self->priv->managed_grab) {
+                return;
+        }
+
         display = gtk_widget_get_display(GTK_WIDGET(self));
         seat = gdk_display_get_default_seat(display);
-
-        gtk_grab_remove(GTK_WIDGET(self));
         gdk_seat_ungrab(seat);
-        self->priv->grabbed = FALSE;
 }
 
 /**
  * Grab was broken, most likely due to a window within our application
  */
-static gboolean budgie_popover_grab_broken(GtkWidget *widget, __budgie_unused__ GdkEvent *event,
-                                           __budgie_unused__ gpointer udata)
+static gboolean budgie_popover_grab_broken(GtkWidget *widget, GdkEventGrabBroken *event)
 {
         BudgiePopover *self = NULL;
+        GtkWidgetClass *parent_class = GTK_WIDGET_CLASS(budgie_popover_parent_class);
 
         self = BUDGIE_POPOVER(widget);
         self->priv->grabbed = FALSE;
+        if (self->priv->manager) {
+                budgie_popover_manager_popover_grab_broken(self->priv->manager, self);
+        }
+
+        if (parent_class->grab_broken_event) {
+                return parent_class->grab_broken_event(widget, event);
+        }
         return GDK_EVENT_PROPAGATE;
 }
 
@@ -324,75 +675,84 @@ static gboolean budgie_popover_grab_broken(GtkWidget *widget, __budgie_unused__
  * If our grab was broken, i.e. due to some popup menu, and we're still visible,
  * we'll now try and grab focus once more.
  */
-static void budgie_popover_grab_notify(GtkWidget *widget, gboolean was_grabbed,
-                                       __budgie_unused__ gpointer udata)
+static void budgie_popover_grab_notify(GtkWidget *widget, gboolean was_grabbed)
 {
         BudgiePopover *self = NULL;
+        GtkWidgetClass *parent_class = GTK_WIDGET_CLASS(budgie_popover_parent_class);
+
+        if (parent_class->grab_notify) {
+                parent_class->grab_notify(widget, was_grabbed);
+        }
 
         /* Only interested in unshadowed */
         if (!was_grabbed) {
                 return;
         }
 
-        budgie_popover_ungrab(BUDGIE_POPOVER(widget));
+        self = BUDGIE_POPOVER(widget);
 
         /* And being visible. ofc. */
         if (!gtk_widget_get_visible(widget)) {
+                budgie_popover_ungrab(self);
                 return;
         }
 
-        self = BUDGIE_POPOVER(widget);
-        budgie_popover_grab(self);
-        budgie_popover_ungrab(BUDGIE_POPOVER(widget));
-        budgie_popover_grab(self);
+        if (!self->priv->grabbed) {
+                budgie_popover_grab(self);
+                return;
+        }
+
+        /* Take the seat back in place, no need to drop it first */
+        if (!self->priv->managed_grab) {
+                budgie_popover_grab_seat(self);
+        }
 }
 
 /**
  * Work out the geometry for the relative_to widget in absolute coordinates
- * on the screen.
+ * on the screen. This is served from the shared geometry cache, which is kept
+ * up to date by allocation and configure events.
  */
 static void budgie_popover_compute_widget_geometry(GtkWidget *parent_widget, GdkRectangle *target)
 {
-        GtkAllocation alloc = { 0 };
-        GtkWidget *toplevel = NULL;
-        GdkWindow *toplevel_window = NULL;
-        gint rx, ry = 0;
-        gint x, y = 0;
-
         if (!parent_widget) {
                 g_warning("compute_widget_geometry(): missing relative_widget");
                 return;
         }
 
-        toplevel = gtk_widget_get_toplevel(parent_widget);
-        toplevel_window = gtk_widget_get_window(toplevel);
-        gdk_window_get_position(toplevel_window, &x, &y);
-        gtk_widget_translate_coordinates(parent_widget, toplevel, x, y, &rx, &ry);
-        gtk_widget_get_allocation(parent_widget, &alloc);
-
-        *target = (GdkRectangle){.x = rx, .y = ry, .width = alloc.width, .height = alloc.height };
+        budgie_geometry_cache_get(parent_widget, target);
 }
 
 /**
- * Use the appropriate function to find out the monitor's resolution for the
- * given @widget.
+ * Use the appropriate function to find out the work area of the monitor for
+ * the given @widget, which lives at @widget_rect on screen. Keeping to the
+ * work area keeps us clear of struts, i.e. docks and other panels.
  */
-static void budgie_popover_get_screen_for_widget(GtkWidget *widget, GdkRectangle *rectangle)
+static void budgie_popover_get_screen_for_widget(GtkWidget *widget, GdkRectangle *widget_rect,
+                                                 GdkRectangle *rectangle)
 {
         GdkScreen *screen = NULL;
         GdkWindow *assoc_window = NULL;
         GdkDisplay *display = NULL;
+        BudgieMonitorInfo info = { 0 };
 
-        assoc_window = gtk_widget_get_parent_window(widget);
         screen = gtk_widget_get_screen(widget);
+
+        /* Use the shared monitor table whenever we can */
+        if (budgie_monitor_cache_lookup(screen, widget_rect, &info)) {
+                *rectangle = info.workarea;
+                return;
+        }
+
+        assoc_window = gtk_widget_get_parent_window(widget);
         display = gdk_screen_get_display(screen);
 
 #if GTK_CHECK_VERSION(3, 22, 0)
         GdkMonitor *monitor = gdk_display_get_monitor_at_window(display, assoc_window);
-        gdk_monitor_get_geometry(monitor, rectangle);
+        gdk_monitor_get_workarea(monitor, rectangle);
 #else
         gint monitor = gdk_screen_get_monitor_at_window(screen, assoc_window);
-        gdk_screen_get_monitor_geometry(screen, monitor, rectangle);
+        gdk_screen_get_monitor_workarea(screen, monitor, rectangle);
 #endif
 }
 
@@ -400,287 +760,572 @@ static void budgie_popover_get_screen_for_widget(GtkWidget *widget, GdkRectangle
  * Select the position of the popover tail (and extend outwards from it)
  * based on the hints provided by the toplevel
  */
-static GtkPositionType budgie_popover_select_position_toplevel(BudgiePopover *self)
+static BudgiePlacementEdge budgie_popover_select_position_toplevel(GtkWidget *parent_window)
 {
-        GtkWidget *parent_window = NULL;
-
         /* Tail points out from the panel */
-        parent_window = gtk_widget_get_toplevel(self->priv->relative_to);
         if (!parent_window) {
-                return GTK_POS_BOTTOM;
+                return BUDGIE_PLACEMENT_EDGE_BOTTOM;
         }
 
         GtkStyleContext *context = gtk_widget_get_style_context(parent_window);
         if (gtk_style_context_has_class(context, "top")) {
-                return GTK_POS_TOP;
+                return BUDGIE_PLACEMENT_EDGE_TOP;
         } else if (gtk_style_context_has_class(context, "left")) {
-                return GTK_POS_LEFT;
+                return BUDGIE_PLACEMENT_EDGE_LEFT;
         } else if (gtk_style_context_has_class(context, "right")) {
-                return GTK_POS_RIGHT;
+                return BUDGIE_PLACEMENT_EDGE_RIGHT;
         }
 
-        return GTK_POS_BOTTOM;
+        return BUDGIE_PLACEMENT_EDGE_BOTTOM;
 }
 
 /**
- * Select the position based on the amount of space available in the given
- * regions.
- *
- * Typically we'll always try to display underneath first, and failing that
- * we'll try to appear above.  If we're still estate-limited, we'll then try
- * the right hand side, before finally falling back to the left hand side for display.
- *
- * The side options will also utilise Y-offsets and bounding to ensure there
- * is always some way to fit the popover sanely on screen.
+ * The toplevel changed its style, so its edge hint may have changed too
  */
-static GtkPositionType budgie_popover_select_position_automatic(gint our_height,
-                                                                GdkRectangle screen_rect,
-                                                                GdkRectangle widget_rect)
+static void budgie_popover_toplevel_style_updated(__budgie_unused__ GtkWidget *toplevel,
+                                                  BudgiePopover *self)
 {
-        /* Try to show the popover underneath */
-        if (widget_rect.y + widget_rect.height + TAIL_HEIGHT + SHADOW_DIMENSION + our_height <=
-            screen_rect.y + screen_rect.height) {
-                return GTK_POS_TOP;
+        self->priv->toplevel_edge_valid = FALSE;
+}
+
+/**
+ * Start listening for style changes on @toplevel instead of the toplevel we
+ * were previously watching. Passing NULL simply stops watching. A manager
+ * watches each toplevel once for all of its popovers, so managed popovers
+ * only remember which toplevel they're on.
+ */
+static void budgie_popover_watch_toplevel(BudgiePopover *self, GtkWidget *toplevel)
+{
+        if (self->priv->hint_toplevel == toplevel) {
+                return;
         }
 
-        /* Now try to show the popover above the widget */
-        if (widget_rect.y - TAIL_HEIGHT - SHADOW_DIMENSION - our_height >= screen_rect.y) {
-                return GTK_POS_BOTTOM;
+        if (self->priv->hint_toplevel) {
+                if (self->priv->hint_toplevel_id > 0) {
+                        g_signal_handler_disconnect(self->priv->hint_toplevel,
+                                                    self->priv->hint_toplevel_id);
+                        self->priv->hint_toplevel_id = 0;
+                }
+                g_object_remove_weak_pointer(G_OBJECT(self->priv->hint_toplevel),
+                                             (gpointer *)&self->priv->hint_toplevel);
         }
 
-        /* Work out which has more room, left or right. */
-        double room_right = screen_rect.x + screen_rect.width - (widget_rect.x + widget_rect.width);
-        double room_left = widget_rect.x - screen_rect.x;
+        self->priv->hint_toplevel = toplevel;
+        self->priv->toplevel_edge_valid = FALSE;
 
-        if (room_left > room_right) {
-                return GTK_POS_RIGHT;
+        if (!toplevel) {
+                return;
         }
 
-        return GTK_POS_LEFT;
+        g_object_add_weak_pointer(G_OBJECT(toplevel), (gpointer *)&self->priv->hint_toplevel);
+        if (self->priv->manager) {
+                return;
+        }
+        self->priv->hint_toplevel_id =
+            g_signal_connect(toplevel,
+                             "style-updated",
+                             G_CALLBACK(budgie_popover_toplevel_style_updated),
+                             self);
 }
 
 /**
- * Work out exactly where the popover needs to appear on screen
- *
- * This will try to account for all potential positions, using a fairly
- * biased view of what the popover should do in each situation.
+ * Follow the compositor coming and going on our screen ourselves, or stop
+ * doing so because a manager tells us instead
+ */
+static void budgie_popover_watch_screen(BudgiePopover *self, gboolean watch)
+{
+        GdkScreen *screen = gtk_widget_get_screen(GTK_WIDGET(self));
+
+        if (!watch) {
+                if (self->priv->screen_id > 0) {
+                        g_signal_handler_disconnect(screen, self->priv->screen_id);
+                        self->priv->screen_id = 0;
+                }
+                return;
+        }
+        if (self->priv->screen_id > 0) {
+                return;
+        }
+        self->priv->screen_id =
+            g_signal_connect_swapped(screen,
+                                     "composited-changed",
+                                     G_CALLBACK(budgie_popover_update_render_mode),
+                                     self);
+}
+
+/**
+ * Return the edge hinted by the toplevel of relative_to, only consulting its
+ * style classes when they may have changed.
+ */
+static BudgiePlacementEdge budgie_popover_get_toplevel_edge(BudgiePopover *self)
+{
+        GtkWidget *toplevel = NULL;
+
+        toplevel = gtk_widget_get_toplevel(self->priv->relative_to);
+        budgie_popover_watch_toplevel(self, toplevel);
+
+        if (!self->priv->toplevel_edge_valid) {
+                self->priv->metrics.toplevel_edge =
+                    budgie_popover_select_position_toplevel(toplevel);
+                self->priv->toplevel_edge_valid = TRUE;
+        }
+
+        return self->priv->metrics.toplevel_edge;
+}
+
+/**
+ * Refresh our style metrics if the style has changed since we last looked
+ */
+static const BudgieStyleMetrics *budgie_popover_get_metrics(BudgiePopover *self)
+{
+        BudgieStyleMetrics *metrics = &(self->priv->metrics);
+        GtkStyleContext *style = NULL;
+
+        if (self->priv->metrics_serial == self->priv->style_serial) {
+                return metrics;
+        }
+
+        gtk_widget_style_get(GTK_WIDGET(self),
+                             "tail-dimension",
+                             &metrics->tail_dimension,
+                             "shadow-dimension",
+                             &metrics->shadow_dimension,
+                             NULL);
+        if (self->priv->render_mode == BUDGIE_POPOVER_RENDER_OPAQUE) {
+                metrics->shadow_dimension = 0;
+        }
+
+        style = gtk_widget_get_style_context(GTK_WIDGET(self));
+        gtk_style_context_get(style,
+                              gtk_style_context_get_state(style),
+                              GTK_STYLE_PROPERTY_BORDER_RADIUS,
+                              &metrics->border_radius,
+                              NULL);
+
+        /* Saved so the state change doesn't invalidate the style */
+        gtk_style_context_save(style);
+        gtk_style_context_set_state(style, GTK_STATE_FLAG_BACKDROP);
+        /* Warning: Using deprecated API */
+        G_GNUC_BEGIN_IGNORE_DEPRECATIONS
+        gtk_style_context_get_border_color(style, GTK_STATE_FLAG_VISITED, &metrics->border_color);
+        G_GNUC_END_IGNORE_DEPRECATIONS
+        gtk_style_context_restore(style);
+
+        self->priv->metrics_serial = self->priv->style_serial;
+        return metrics;
+}
+
+/**
+ * Gather the widget state that the placement engine needs and work out
+ * exactly where the popover needs to appear on screen.
  *
- * Unlike a typical popover implementation, this relies on some information
- * from the toplevel window on what edge it happens to be on.
+ * Nothing is applied to the widget here, the caller should pass the result
+ * to budgie_popover_apply_placement()
  */
-static void budgie_popover_compute_positition(BudgiePopover *self, GdkRectangle *target)
+static void budgie_popover_compute_positition(BudgiePopover *self, BudgiePlacement *placement)
 {
+        const BudgieStyleMetrics *metrics = NULL;
+        BudgiePlacementInput input;
         GdkRectangle widget_rect = { 0 };
-        GtkPositionType tail_position = GTK_POS_BOTTOM;
-        gint our_width = 0, our_height = 0;
-        GtkStyleContext *style = NULL;
-        int x = 0, y = 0, width = 0, height = 0;
-        static const gchar *position_classes[] = { "top", "left", "right", "bottom" };
-        const gchar *style_class = NULL;
         GdkRectangle display_geom = { 0 };
+        gboolean hit = FALSE;
+        gint64 start = g_get_monotonic_time();
+
+        /* Zeroed first so that the memo can compare inputs directly */
+        memset(&input, 0, sizeof(input));
 
         /* Find out where the widget is on screen */
         budgie_popover_compute_widget_geometry(self->priv->relative_to, &widget_rect);
 
-        /* Work out our own size */
-        gtk_window_get_size(GTK_WINDOW(self), &our_width, &our_height);
+        /* Work out the usable screen area involved here */
+        budgie_popover_get_screen_for_widget(self->priv->relative_to, &widget_rect, &display_geom);
+
+        input.anchor = (BudgiePlacementRect){.x = widget_rect.x,
+                                             .y = widget_rect.y,
+                                             .width = widget_rect.width,
+                                             .height = widget_rect.height };
+        input.monitor = (BudgiePlacementRect){.x = display_geom.x,
+                                              .y = display_geom.y,
+                                              .width = display_geom.width,
+                                              .height = display_geom.height };
 
-        /* Work out the real screen geometry involved here */
-        budgie_popover_get_screen_for_widget(self->priv->relative_to, &display_geom);
+        /* Work out our own size */
+        gtk_window_get_size(GTK_WINDOW(self), &input.width, &input.height);
 
         if (self->priv->policy == BUDGIE_POPOVER_POSITION_TOPLEVEL_HINT) {
-                tail_position = budgie_popover_select_position_toplevel(self);
+                input.automatic = FALSE;
+                input.edge = budgie_popover_get_toplevel_edge(self);
         } else {
-                tail_position =
-                    budgie_popover_select_position_automatic(our_height, display_geom, widget_rect);
-        }
-
-        /* Now work out where we live on screen */
-        switch (tail_position) {
-        case GTK_POS_BOTTOM:
-                /* We need to appear above the widget */
-                y = widget_rect.y - our_height;
-                x = (widget_rect.x + (widget_rect.width / 2)) - (our_width / 2);
-                g_object_set(self->priv->add_area,
-                             "margin-top",
-                             5,
-                             "margin-bottom",
-                             15,
-                             "margin-start",
-                             5,
-                             "margin-end",
-                             5,
-                             NULL);
-                style_class = "bottom";
-                break;
-        case GTK_POS_TOP:
-                /* We need to appear below the widget */
-                y = widget_rect.y + widget_rect.height + (TAIL_DIMENSION / 2);
-                x = (widget_rect.x + (widget_rect.width / 2)) - (our_width / 2);
-                g_object_set(self->priv->add_area,
-                             "margin-top",
-                             10,
-                             "margin-bottom",
-                             10,
-                             "margin-start",
-                             5,
-                             "margin-end",
-                             5,
-                             NULL);
-                style_class = "top";
-                break;
-        case GTK_POS_LEFT:
-                /* We need to appear to the right of the widget */
-                y = (widget_rect.y + (widget_rect.height / 2)) - (our_height / 2);
-                y += TAIL_DIMENSION / 4;
-                x = widget_rect.x + widget_rect.width;
-                g_object_set(self->priv->add_area,
-                             "margin-top",
-                             5,
-                             "margin-bottom",
-                             10,
-                             "margin-start",
-                             15,
-                             "margin-end",
-                             5,
-                             NULL);
-                style_class = "left";
-                break;
-        case GTK_POS_RIGHT:
-                y = (widget_rect.y + (widget_rect.height / 2)) - (our_height / 2);
-                y += TAIL_DIMENSION / 4;
-                x = widget_rect.x - our_width;
-                g_object_set(self->priv->add_area,
-                             "margin-top",
-                             5,
-                             "margin-bottom",
-                             10,
-                             "margin-start",
-                             5,
-                             "margin-end",
-                             15,
-                             NULL);
-                style_class = "right";
-                break;
+                input.automatic = TRUE;
+        }
+
+        metrics = budgie_popover_get_metrics(self);
+        input.tail_dimension = metrics->tail_dimension;
+        input.shadow_dimension = metrics->shadow_dimension;
+
+        hit = budgie_placement_memo_compute(&self->priv->placement_memo, &input, placement);
+
+        budgie_stats_record(&self->priv->stats,
+                            BUDGIE_STATS_PLACEMENT,
+                            g_get_monotonic_time() - start);
+        budgie_stats_count(&self->priv->stats,
+                           hit ? BUDGIE_STATS_PLACEMENT_HITS : BUDGIE_STATS_PLACEMENT_MISSES);
+}
+
+/**
+ * Map the tail position to the CSS class we expose to themers
+ */
+static const gchar *budgie_popover_position_class(BudgiePlacementEdge position)
+{
+        switch (position) {
+        case BUDGIE_PLACEMENT_EDGE_TOP:
+                return "top";
+        case BUDGIE_PLACEMENT_EDGE_LEFT:
+                return "left";
+        case BUDGIE_PLACEMENT_EDGE_RIGHT:
+                return "right";
+        case BUDGIE_PLACEMENT_EDGE_BOTTOM:
         default:
-                break;
+                return "bottom";
         }
+}
 
-        /* Update tail knowledge */
-        self->priv->tail.position = tail_position;
-        budgie_popover_compute_tail(self);
+/**
+ * Apply the result of a placement pass, only touching the margins and CSS
+ * classes when they actually differ from the last pass. This avoids needless
+ * relayouts and CSS invalidation on every size_allocate.
+ *
+ * Returns: TRUE if the window origin changed
+ */
+static gboolean budgie_popover_apply_placement(BudgiePopover *self, BudgiePlacement *placement)
+{
+        BudgiePlacement *old = &(self->priv->placement);
+        gboolean valid = self->priv->placement_valid;
+        GtkStyleContext *style = NULL;
+        GtkWidget *area = self->priv->add_area;
+        gboolean moved = FALSE;
+
+        if (!valid || memcmp(&old->margin, &placement->margin, sizeof(old->margin)) != 0) {
+                /* Batch up the notifies for the margin properties */
+                g_object_freeze_notify(G_OBJECT(area));
+                if (!valid || old->margin.top != placement->margin.top) {
+                        gtk_widget_set_margin_top(area, placement->margin.top);
+                }
+                if (!valid || old->margin.bottom != placement->margin.bottom) {
+                        gtk_widget_set_margin_bottom(area, placement->margin.bottom);
+                }
+                if (!valid || old->margin.start != placement->margin.start) {
+                        gtk_widget_set_margin_start(area, placement->margin.start);
+                }
+                if (!valid || old->margin.end != placement->margin.end) {
+                        gtk_widget_set_margin_end(area, placement->margin.end);
+                }
+                g_object_thaw_notify(G_OBJECT(area));
+        }
 
         /* Allow themers to know what kind of popover this is, and set the
          * CSS class in accordance with the direction that the popover is
          * pointing in.
          */
-        style = gtk_widget_get_style_context(GTK_WIDGET(self));
-        for (guint i = 0; i < G_N_ELEMENTS(position_classes); i++) {
-                gtk_style_context_remove_class(style, position_classes[i]);
-        }
-
-        gtk_style_context_add_class(style, style_class);
-
-        static int pad_num = 1;
-
-        /* Bound X to display width */
-        if (x < display_geom.x) {
-                self->priv->tail.x_offset += (x - (display_geom.x + pad_num));
-                x -= (int)(self->priv->tail.x_offset);
-        } else if ((x + our_width) >= display_geom.x + display_geom.width) {
-                self->priv->tail.x_offset -=
-                    ((display_geom.x + display_geom.width) - (our_width + pad_num)) - x;
-                x -= (int)(self->priv->tail.x_offset);
+        if (!valid || old->tail.position != placement->tail.position) {
+                style = gtk_widget_get_style_context(GTK_WIDGET(self));
+                if (valid) {
+                        gtk_style_context_remove_class(style,
+                                                       budgie_popover_position_class(
+                                                           old->tail.position));
+                }
+                gtk_style_context_add_class(style,
+                                            budgie_popover_position_class(
+                                                placement->tail.position));
         }
 
-        double display_tail_x = x + self->priv->tail.x + self->priv->tail.x_offset;
-        double display_tail_y = y + self->priv->tail.y + self->priv->tail.y_offset;
-        static double required_offset_x = TAIL_DIMENSION * 1.25;
-        static double required_offset_y = TAIL_DIMENSION * 1.75;
+        moved = !valid || old->x != placement->x || old->y != placement->y;
 
-        /* Prevent the tail pointer spilling outside the X bounds */
-        if (display_tail_x <= display_geom.x + required_offset_x) {
-                self->priv->tail.x_offset += (display_geom.x + required_offset_x) - display_tail_x;
-        } else if (display_tail_x >= ((display_geom.x + display_geom.width) - required_offset_x)) {
-                self->priv->tail.x_offset -=
-                    (display_tail_x + required_offset_x) - (display_geom.x + display_geom.width);
+        /* Pure moves don't touch the chrome, but a shifted tail does */
+        if (valid && self->priv->tail.position != placement->tail.position) {
+                gtk_widget_queue_draw(GTK_WIDGET(self));
+        } else if (valid && memcmp(&self->priv->tail, &placement->tail, sizeof(BudgieTail)) != 0) {
+                budgie_popover_damage_tail(self, &self->priv->tail);
+                budgie_popover_damage_tail(self, &placement->tail);
         }
 
-        /* Prevent the tail pointer spilling outside the Y bounds */
-        if (display_tail_y <= display_geom.y + required_offset_y) {
-                self->priv->tail.y_offset += (display_geom.y + required_offset_y) - display_tail_y;
-        } else if (display_tail_y >= ((display_geom.y + display_geom.height) - required_offset_y)) {
-                self->priv->tail.y_offset -=
-                    (display_tail_y + required_offset_y) - (display_geom.y + display_geom.height);
-        }
+        self->priv->tail = placement->tail;
+        self->priv->placement = *placement;
+        self->priv->placement_valid = TRUE;
 
-        /* Bound Y to display height */
-        if (y < display_geom.y) {
-                self->priv->tail.y_offset += (y - (display_geom.y + pad_num));
-                y -= (int)(self->priv->tail.y_offset);
-        } else if ((y + our_height) >= display_geom.y + display_geom.height) {
-                self->priv->tail.y_offset -=
-                    ((display_geom.y + display_geom.height) - (our_height + pad_num)) - y;
-                y -= (int)(self->priv->tail.y_offset);
-        }
+        return moved;
+}
 
-        /* Set the target rectangle */
-        *target = (GdkRectangle){.x = x, .y = y, .width = width, .height = height };
+/**
+ * Compute the tail for the given position on a popover of size @alloc,
+ * centred along its edge and without any offsets applied.
+ */
+static void budgie_popover_tail_for_allocation(BudgiePopover *self, BudgiePlacementEdge position,
+                                               GtkAllocation *alloc, BudgieTail *tail)
+{
+        const BudgieStyleMetrics *metrics = budgie_popover_get_metrics(self);
+        BudgiePlacementRect area = {.x = alloc->x,
+                                    .y = alloc->y,
+                                    .width = alloc->width,
+                                    .height = alloc->height };
+
+        budgie_placement_compute_tail(position,
+                                      &area,
+                                      metrics->tail_dimension,
+                                      metrics->shadow_dimension,
+                                      tail);
 }
 
 static void budgie_popover_compute_tail(BudgiePopover *self)
 {
         GtkAllocation alloc = { 0 };
-        BudgieTail t = { 0 };
 
         gtk_widget_get_allocation(GTK_WIDGET(self), &alloc);
+        budgie_popover_tail_for_allocation(self,
+                                           self->priv->tail.position,
+                                           &alloc,
+                                           &self->priv->tail);
+}
+
+/**
+ * Bounding box of the tail triangle, with its offsets applied
+ */
+static void budgie_popover_tail_extents(BudgieTail *tail, GdkRectangle *rect)
+{
+        gdouble x1, y1, x2, y2 = 0;
 
-        t.position = self->priv->tail.position;
+        x1 = MIN(MIN(tail->start_x, tail->end_x), tail->x) + tail->x_offset;
+        x2 = MAX(MAX(tail->start_x, tail->end_x), tail->x) + tail->x_offset;
+        y1 = MIN(MIN(tail->start_y, tail->end_y), tail->y) + tail->y_offset;
+        y2 = MAX(MAX(tail->start_y, tail->end_y), tail->y) + tail->y_offset;
 
-        switch (self->priv->tail.position) {
-        case GTK_POS_LEFT:
-                t.x = alloc.x;
-                t.y = alloc.y + (alloc.height / 2);
-                t.start_y = t.y - TAIL_HEIGHT;
-                t.end_y = t.y + TAIL_HEIGHT;
-                t.start_x = t.end_x = t.x + TAIL_HEIGHT + SHADOW_DIMENSION;
+        *rect = (GdkRectangle){.x = (gint)x1,
+                               .y = (gint)y1,
+                               .width = (gint)(x2 - x1) + 1,
+                               .height = (gint)(y2 - y1) + 1 };
+}
+
+/**
+ * Add the tail triangle to @region as a run of 1 pixel strips, stepping from
+ * the base to the tip, so that it can shape an opaque window
+ */
+static void budgie_popover_tail_region(BudgieTail *tail, cairo_region_t *region)
+{
+        gboolean vertical = tail->position == BUDGIE_PLACEMENT_EDGE_LEFT ||
+                            tail->position == BUDGIE_PLACEMENT_EDGE_RIGHT;
+        gdouble base = vertical ? tail->start_x : tail->start_y;
+        gdouble tip = vertical ? tail->x : tail->y;
+        gdouble half = vertical ? (tail->end_y - tail->start_y) / 2
+                                : (tail->end_x - tail->start_x) / 2;
+        gint depth = (gint)ABS(tip - base);
+        gint step = tip < base ? -1 : 1;
+
+        for (gint i = 0; i < MAX(depth, 1); i++) {
+                gdouble extent = depth > 0 ? half * (depth - i) / depth : half;
+                cairo_rectangle_int_t strip = { 0 };
+
+                if (vertical) {
+                        strip.x = (gint)(base + tail->x_offset) + (i * step) - (step < 0 ? 1 : 0);
+                        strip.y = (gint)(tail->y + tail->y_offset - extent);
+                        strip.width = 1;
+                        strip.height = MAX((gint)(extent * 2), 1);
+                } else {
+                        strip.x = (gint)(tail->x + tail->x_offset - extent);
+                        strip.y = (gint)(base + tail->y_offset) + (i * step) - (step < 0 ? 1 : 0);
+                        strip.width = MAX((gint)(extent * 2), 1);
+                        strip.height = 1;
+                }
+                cairo_region_union_rectangle(region, &strip);
+        }
+}
+
+/**
+ * Work out the area of @alloc occupied by the body, i.e. everything except
+ * the shadow and the tail
+ */
+static void budgie_popover_body_for_allocation(BudgiePopover *self, GtkAllocation *alloc,
+                                               BudgieTail *tail, GtkAllocation *body)
+{
+        const BudgieStyleMetrics *metrics = budgie_popover_get_metrics(self);
+        gint shadow = metrics->shadow_dimension;
+        gint tail_height = metrics->tail_dimension / 2;
+
+        *body = *alloc;
+        body->x += shadow;
+        body->width -= shadow * 2;
+        body->y += shadow;
+        body->height -= shadow * 2;
+
+        switch (tail->position) {
+        case BUDGIE_PLACEMENT_EDGE_LEFT:
+                body->height -= shadow;
+                body->width -= tail_height;
+                body->x += tail_height;
                 break;
-        case GTK_POS_RIGHT:
-                t.x = alloc.width;
-                t.y = alloc.y + (alloc.height / 2);
-                t.start_y = t.y - TAIL_HEIGHT;
-                t.end_y = t.y + TAIL_HEIGHT;
-                t.start_x = t.end_x = t.x - TAIL_HEIGHT - SHADOW_DIMENSION;
+        case BUDGIE_PLACEMENT_EDGE_RIGHT:
+                body->height -= shadow;
+                body->width -= tail_height;
                 break;
-        case GTK_POS_TOP:
-                t.x = (alloc.x + alloc.width / 2);
-                t.y = alloc.y;
-                t.start_x = t.x - TAIL_HEIGHT;
-                t.end_x = t.start_x + TAIL_DIMENSION;
-                t.start_y = t.y + TAIL_HEIGHT;
-                t.end_y = t.start_y;
+        case BUDGIE_PLACEMENT_EDGE_TOP:
+                body->height -= shadow * 2;
+                body->y += tail_height;
+                body->y -= shadow;
                 break;
-        case GTK_POS_BOTTOM:
+        case BUDGIE_PLACEMENT_EDGE_BOTTOM:
         default:
-                t.x = (alloc.x + alloc.width / 2);
-                t.y = (alloc.y + alloc.height) - SHADOW_DIMENSION;
-                t.start_x = t.x - TAIL_HEIGHT;
-                t.end_x = t.start_x + TAIL_DIMENSION;
-                t.start_y = t.y - TAIL_HEIGHT;
-                t.end_y = t.start_y;
+                body->height -= tail_height;
                 break;
         }
+}
 
-        self->priv->tail = t;
+/**
+ * Tell the compositor that everything outside of the body is shadow (or
+ * tail), so it can treat the body as the real window extents rather than
+ * our full surface. Only updated when the extents actually change.
+ */
+static void budgie_popover_update_shadow_width(BudgiePopover *self, GtkAllocation *alloc,
+                                               GtkAllocation *body)
+{
+        GdkWindow *window = gtk_widget_get_window(GTK_WIDGET(self));
+        GtkBorder border = { 0 };
+
+        if (!window) {
+                return;
+        }
+
+        /* Opaque windows are shaped to the body, so there's nothing to advertise */
+        if (self->priv->render_mode == BUDGIE_POPOVER_RENDER_COMPOSITED) {
+                border.left = (gint16)(body->x - alloc->x);
+                border.top = (gint16)(body->y - alloc->y);
+                border.right = (gint16)((alloc->x + alloc->width) - (body->x + body->width));
+                border.bottom = (gint16)((alloc->y + alloc->height) - (body->y + body->height));
+        }
+
+        if (memcmp(&border, &self->priv->shadow_width, sizeof(border)) == 0) {
+                return;
+        }
+        self->priv->shadow_width = border;
+        gdk_window_set_shadow_width(window, border.left, border.right, border.top, border.bottom);
 }
 
 /**
- * Draw the actual tail itself.
+ * Only the body and tail accept input, so that clicks on the transparent
+ * shadow margins go straight through. In the opaque render mode the same
+ * region also shapes the window itself. This is recomputed only when our
+ * size, tail or style changes.
  */
-static void budgie_popover_draw_tail(BudgiePopover *self, cairo_t *cr)
+static void budgie_popover_update_input_shape(BudgiePopover *self)
 {
-        BudgieTail *tail = &(self->priv->tail);
+        BudgieChromeKey key;
+        GtkAllocation alloc = { 0 };
+        GtkAllocation body = { 0 };
+        cairo_region_t *region = NULL;
+        gboolean shaped = self->priv->render_mode == BUDGIE_POPOVER_RENDER_OPAQUE;
+
+        gtk_widget_get_allocation(GTK_WIDGET(self), &alloc);
+
+        memset(&key, 0, sizeof(key));
+        key.width = alloc.width;
+        key.height = alloc.height;
+        key.position = self->priv->tail.position;
+        key.x_offset = self->priv->tail.x_offset;
+        key.y_offset = self->priv->tail.y_offset;
+        key.style_serial = self->priv->style_serial;
+
+        if (self->priv->input_shape && memcmp(&key, &self->priv->shape_key, sizeof(key)) == 0) {
+                return;
+        }
+        self->priv->shape_key = key;
+
+        budgie_popover_body_for_allocation(self, &alloc, &self->priv->tail, &body);
+        budgie_popover_update_shadow_width(self, &alloc, &body);
 
+        region = cairo_region_create_rectangle(&body);
+        budgie_popover_tail_region(&self->priv->tail, region);
+
+        if (self->priv->input_shape && cairo_region_equal(region, self->priv->input_shape) &&
+            shaped == self->priv->shaped) {
+                cairo_region_destroy(region);
+                return;
+        }
+
+        g_clear_pointer(&self->priv->input_shape, cairo_region_destroy);
+        self->priv->input_shape = region;
+        gtk_widget_input_shape_combine_region(GTK_WIDGET(self), region);
+
+        if (shaped) {
+                gtk_widget_shape_combine_region(GTK_WIDGET(self), region);
+        } else if (self->priv->shaped) {
+                gtk_widget_shape_combine_region(GTK_WIDGET(self), NULL);
+        }
+        self->priv->shaped = shaped;
+}
+
+/**
+ * Invalidate just the strip of the window covered by @tail, including the
+ * gap it cuts into the frame
+ */
+static void budgie_popover_damage_tail(BudgiePopover *self, BudgieTail *tail)
+{
+        const BudgieStyleMetrics *metrics = budgie_popover_get_metrics(self);
+        gint pad = metrics->shadow_dimension + 2;
+        GdkRectangle rect = { 0 };
+
+        budgie_popover_tail_extents(tail, &rect);
+        gtk_widget_queue_draw_area(GTK_WIDGET(self),
+                                   rect.x - pad,
+                                   rect.y - pad,
+                                   rect.width + pad * 2,
+                                   rect.height + pad * 2);
+}
+
+/**
+ * Our window grows and shrinks from the top left, so after a resize only the
+ * bands along the right and bottom edges can differ from what is on screen.
+ * When placement also @moved the origin, say to recentre us, the left and top
+ * edges shifted underneath us too, so the whole chrome band is redrawn.
+ * Any tail movement is handled by budgie_popover_apply_placement(), and the
+ * content invalidates its own allocation.
+ */
+static void budgie_popover_damage_resize(BudgiePopover *self, GtkAllocation *old,
+                                         GtkAllocation *alloc, gboolean moved)
+{
+        const BudgieStyleMetrics *metrics = budgie_popover_get_metrics(self);
+        GtkWidget *widget = GTK_WIDGET(self);
+        gint inset = 0;
+        gint width = MAX(old->width, alloc->width);
+        gint height = MAX(old->height, alloc->height);
+        gint edge = 0;
+
+        /* Everything drawn inside of the edge: shadow, tail, frame and corners */
+        inset = metrics->shadow_dimension * 3 + metrics->tail_dimension / 2 +
+                metrics->border_radius + 1;
+
+        if (moved) {
+                gtk_widget_queue_draw_area(widget, 0, 0, width, MIN(inset, height));
+                gtk_widget_queue_draw_area(widget, 0, 0, MIN(inset, width), height);
+                edge = MAX(MIN(old->width, alloc->width) - inset, 0);
+                gtk_widget_queue_draw_area(widget, edge, 0, width - edge, height);
+                edge = MAX(MIN(old->height, alloc->height) - inset, 0);
+                gtk_widget_queue_draw_area(widget, 0, edge, width, height - edge);
+                return;
+        }
+
+        if (old->width != alloc->width) {
+                edge = MAX(MIN(old->width, alloc->width) - inset, 0);
+                gtk_widget_queue_draw_area(widget, edge, 0, width - edge, height);
+        }
+        if (old->height != alloc->height) {
+                edge = MAX(MIN(old->height, alloc->height) - inset, 0);
+                gtk_widget_queue_draw_area(widget, 0, edge, width, height - edge);
+        }
+}
+
+/**
+ * Draw the actual tail itself.
+ */
+static void budgie_popover_draw_tail(BudgieTail *tail, cairo_t *cr)
+{
         /* Draw "through" the previous box-shadow */
         cairo_set_operator(cr, CAIRO_OPERATOR_SOURCE);
         cairo_set_line_cap(cr, CAIRO_LINE_CAP_BUTT);
@@ -692,74 +1337,129 @@ static void budgie_popover_draw_tail(BudgiePopover *self, cairo_t *cr)
 }
 
 /**
- * Override the drawing to provide a tail region
+ * Add the outline of the body and @tail to the current path
  */
-static gboolean budgie_popover_draw(GtkWidget *widget, cairo_t *cr)
+static void budgie_popover_silhouette_path(BudgiePopover *self, cairo_t *cr, GtkAllocation *alloc,
+                                           BudgieTail *tail)
+{
+        const BudgieStyleMetrics *metrics = budgie_popover_get_metrics(self);
+        GtkAllocation body = { 0 };
+        double r = 0;
+
+        budgie_popover_body_for_allocation(self, alloc, tail, &body);
+
+        r = MIN(metrics->border_radius, MIN(body.width, body.height) / 2);
+        cairo_new_sub_path(cr);
+        cairo_arc(cr, body.x + body.width - r, body.y + r, r, -G_PI / 2, 0);
+        cairo_arc(cr, body.x + body.width - r, body.y + body.height - r, r, 0, G_PI / 2);
+        cairo_arc(cr, body.x + r, body.y + body.height - r, r, G_PI / 2, G_PI);
+        cairo_arc(cr, body.x + r, body.y + r, r, G_PI, G_PI * 1.5);
+        cairo_close_path(cr);
+
+        cairo_move_to(cr, tail->start_x + tail->x_offset, tail->start_y + tail->y_offset);
+        cairo_line_to(cr, tail->x + tail->x_offset, tail->y + tail->y_offset);
+        cairo_line_to(cr, tail->end_x + tail->x_offset, tail->end_y + tail->y_offset);
+        cairo_close_path(cr);
+}
+
+/**
+ * Fill the outline of the body and tail for a popover of the keyed size,
+ * ready to be blurred into its shadow
+ */
+static void budgie_popover_render_silhouette(cairo_t *cr, const BudgieShadowKey *key,
+                                             gpointer udata)
 {
+        BudgiePopover *self = udata;
+        GtkAllocation alloc = {.x = 0, .y = 0, .width = key->width, .height = key->height };
+        BudgieTail tail = { 0 };
+
+        budgie_popover_tail_for_allocation(self, (BudgiePlacementEdge)key->position, &alloc, &tail);
+        tail.x_offset = key->x_offset;
+        tail.y_offset = key->y_offset;
+
+        budgie_popover_silhouette_path(self, cr, &alloc, &tail);
+        cairo_set_fill_rule(cr, CAIRO_FILL_RULE_WINDING);
+        cairo_fill(cr);
+}
+
+/**
+ * Paint our own drop shadow from the blurred silhouette cache, rather than
+ * having the CSS renderer blur a box-shadow every time we render
+ */
+static void budgie_popover_render_shadow(BudgiePopover *self, cairo_t *cr, GtkAllocation *alloc,
+                                         BudgieTail *tail)
+{
+        const BudgieStyleMetrics *metrics = budgie_popover_get_metrics(self);
+        BudgieShadowKey key;
+        cairo_surface_t *mask = NULL;
+
+        if (metrics->shadow_dimension <= SHADOW_OFFSET) {
+                return;
+        }
+
+        /* Zeroed first so that struct padding compares equal */
+        memset(&key, 0, sizeof(key));
+        key.width = alloc->width;
+        key.height = alloc->height;
+        key.position = (GtkPositionType)tail->position;
+        key.x_offset = tail->x_offset;
+        key.y_offset = tail->y_offset;
+        key.radius = MAX((metrics->shadow_dimension - SHADOW_OFFSET) / 3, 1);
+        key.style_serial = self->priv->style_serial;
+
+        mask = budgie_shadow_cache_get(self->priv->shadow, &key);
+
+        /* Only outside of the body, as it isn't entirely opaque */
+        cairo_save(cr);
+        cairo_rectangle(cr, alloc->x, alloc->y, alloc->width, alloc->height);
+        budgie_popover_silhouette_path(self, cr, alloc, tail);
+        cairo_set_fill_rule(cr, CAIRO_FILL_RULE_EVEN_ODD);
+        cairo_clip(cr);
+        cairo_set_source_rgba(cr, 0, 0, 0, SHADOW_OPACITY);
+        cairo_mask_surface(cr, mask, alloc->x, alloc->y + SHADOW_OFFSET);
+        cairo_restore(cr);
+}
+
+/**
+ * Render the background, frame and @tail for the given allocation
+ */
+static void budgie_popover_render_chrome(BudgiePopover *self, cairo_t *cr, GtkAllocation *alloc,
+                                         BudgieTail *tail)
+{
+        const BudgieStyleMetrics *metrics = budgie_popover_get_metrics(self);
         GtkStyleContext *style = NULL;
-        GtkAllocation alloc = { 0 };
-        GtkWidget *child = NULL;
-        GdkRGBA border_color = { 0 };
-        GtkBorder border = { 0 };
-        GtkStateFlags fl;
-        BudgiePopover *self = NULL;
-        BudgieTail *tail = NULL;
         GtkAllocation body_alloc = { 0 };
 
-        self = BUDGIE_POPOVER(widget);
-        tail = &(self->priv->tail);
-        fl = GTK_STATE_FLAG_VISITED;
-
-        cairo_set_antialias(cr, CAIRO_ANTIALIAS_SUBPIXEL);
+        /* Subpixel rendering isn't worth it without a compositor */
+        cairo_set_antialias(cr,
+                            self->priv->render_mode == BUDGIE_POPOVER_RENDER_OPAQUE
+                                ? CAIRO_ANTIALIAS_GRAY
+                                : CAIRO_ANTIALIAS_SUBPIXEL);
 
-        style = gtk_widget_get_style_context(widget);
-        gtk_widget_get_allocation(widget, &alloc);
-        body_alloc = alloc;
+        style = gtk_widget_get_style_context(GTK_WIDGET(self));
 
         /* Set up the offset */
+        budgie_popover_body_for_allocation(self, alloc, tail, &body_alloc);
 
-        gdouble gap_start = 0, gap_end = 0;
+        budgie_popover_render_shadow(self, cr, alloc, tail);
 
-        body_alloc.x += SHADOW_DIMENSION;
-        body_alloc.width -= SHADOW_DIMENSION * 2;
-        body_alloc.y += SHADOW_DIMENSION;
-        body_alloc.height -= SHADOW_DIMENSION * 2;
+        gdouble gap_start = 0, gap_end = 0;
 
-        switch (self->priv->tail.position) {
-        case GTK_POS_LEFT:
-                body_alloc.height -= SHADOW_DIMENSION;
-                body_alloc.width -= TAIL_HEIGHT;
-                body_alloc.x += TAIL_HEIGHT;
-                gap_start = tail->start_y + tail->y_offset;
-                gap_end = tail->end_y + tail->y_offset;
-                break;
-        case GTK_POS_RIGHT:
-                body_alloc.height -= SHADOW_DIMENSION;
-                body_alloc.width -= TAIL_HEIGHT;
+        switch (tail->position) {
+        case BUDGIE_PLACEMENT_EDGE_LEFT:
+        case BUDGIE_PLACEMENT_EDGE_RIGHT:
                 gap_start = tail->start_y + tail->y_offset;
                 gap_end = tail->end_y + tail->y_offset;
                 break;
-        case GTK_POS_TOP:
-                body_alloc.height -= SHADOW_DIMENSION * 2;
-                body_alloc.y += TAIL_HEIGHT;
-                body_alloc.y -= SHADOW_DIMENSION;
-                gap_start = tail->start_x + tail->x_offset;
-                gap_end = tail->end_x + tail->x_offset;
-                break;
-        case GTK_POS_BOTTOM:
         default:
-                body_alloc.height -= TAIL_HEIGHT;
                 gap_start = tail->start_x + tail->x_offset;
                 gap_end = tail->end_x + tail->x_offset;
                 break;
         }
 
+        /* Saved so the state change doesn't invalidate the style (and the cache) */
+        gtk_style_context_save(style);
         gtk_style_context_set_state(style, GTK_STATE_FLAG_BACKDROP);
-        /* Warning: Using deprecated API */
-        G_GNUC_BEGIN_IGNORE_DEPRECATIONS
-        gtk_style_context_get_border_color(style, fl, &border_color);
-        G_GNUC_END_IGNORE_DEPRECATIONS
-        gtk_style_context_get_border(style, fl, &border);
         gtk_render_background(style,
                               cr,
                               body_alloc.x,
@@ -773,32 +1473,227 @@ static gboolean budgie_popover_draw(GtkWidget *widget, cairo_t *cr)
                              body_alloc.y,
                              body_alloc.width,
                              body_alloc.height,
-                             self->priv->tail.position,
+                             (GtkPositionType)tail->position,
                              gap_start,
                              gap_end);
-        gtk_style_context_set_state(style, fl);
-
-        child = gtk_bin_get_child(GTK_BIN(widget));
-        if (child) {
-                gtk_container_propagate_draw(GTK_CONTAINER(widget), child, cr);
-        }
+        gtk_style_context_restore(style);
 
         cairo_set_line_width(cr, 1.3);
         cairo_set_line_cap(cr, CAIRO_LINE_CAP_ROUND);
         cairo_set_line_join(cr, CAIRO_LINE_JOIN_BEVEL);
         cairo_set_source_rgba(cr,
-                              border_color.red,
-                              border_color.green,
-                              border_color.blue,
-                              border_color.alpha);
-        budgie_popover_draw_tail(self, cr);
+                              metrics->border_color.red,
+                              metrics->border_color.green,
+                              metrics->border_color.blue,
+                              metrics->border_color.alpha);
+        budgie_popover_draw_tail(tail, cr);
         cairo_clip(cr);
         cairo_move_to(cr, 0, 0);
-        gtk_render_background(style, cr, alloc.x, alloc.y, alloc.width, alloc.height);
+        gtk_render_background(style, cr, alloc->x, alloc->y, alloc->width, alloc->height);
+}
+
+/**
+ * Render one nine-slice template with a centred tail
+ */
+static void budgie_popover_render_template(cairo_t *cr, GtkPositionType position,
+                                           GtkAllocation *alloc, gpointer udata)
+{
+        BudgiePopover *self = udata;
+        BudgieTail tail = { 0 };
+
+        budgie_popover_tail_for_allocation(self, (BudgiePlacementEdge)position, alloc, &tail);
+        budgie_popover_render_chrome(self, cr, alloc, &tail);
+}
+
+/**
+ * Throw away the nine-slice templates if the style has changed since they
+ * were rendered, updating the slice sizes to match the new style.
+ */
+static void budgie_popover_ensure_slices(BudgiePopover *self)
+{
+        const BudgieStyleMetrics *metrics = NULL;
+        gint corner_extent = 0;
+
+        if (self->priv->slices_serial == self->priv->style_serial) {
+                return;
+        }
+
+        metrics = budgie_popover_get_metrics(self);
+
+        /* Corners must cover the shadow, the tail depth and the rounding */
+        corner_extent =
+            (metrics->shadow_dimension * 4) + metrics->tail_dimension + metrics->border_radius;
+
+        budgie_chrome_slices_invalidate(self->priv->slices,
+                                        corner_extent,
+                                        metrics->tail_dimension);
+        self->priv->slices_serial = self->priv->style_serial;
+}
+
+/**
+ * Ensure the cached chrome surface matches our current state, re-rendering
+ * it only when the size, tail or style has changed.
+ */
+static cairo_surface_t *budgie_popover_get_chrome(BudgiePopover *self, GtkAllocation *alloc)
+{
+        BudgieChromeKey key;
+        GdkWindow *window = NULL;
+        cairo_t *cr = NULL;
+        BudgieTail *tail = &(self->priv->tail);
+        double tail_centre = 0;
+
+        /* Zeroed first so that struct padding compares equal */
+        memset(&key, 0, sizeof(key));
+        key.width = alloc->width;
+        key.height = alloc->height;
+        key.position = self->priv->tail.position;
+        key.x_offset = self->priv->tail.x_offset;
+        key.y_offset = self->priv->tail.y_offset;
+        key.style_serial = self->priv->style_serial;
+
+        if (self->priv->chrome && memcmp(&key, &self->priv->chrome_key, sizeof(key)) == 0) {
+                budgie_stats_count(&self->priv->stats, BUDGIE_STATS_CHROME_HITS);
+                return self->priv->chrome;
+        }
+        budgie_stats_count(&self->priv->stats, BUDGIE_STATS_CHROME_MISSES);
+
+        budgie_popover_ensure_slices(self);
+
+        g_clear_pointer(&self->priv->chrome, cairo_surface_destroy);
+
+        window = gtk_widget_get_window(GTK_WIDGET(self));
+        self->priv->chrome = gdk_window_create_similar_surface(
+            window,
+            self->priv->render_mode == BUDGIE_POPOVER_RENDER_OPAQUE ? CAIRO_CONTENT_COLOR
+                                                                    : CAIRO_CONTENT_COLOR_ALPHA,
+            alloc->width,
+            alloc->height);
+        self->priv->chrome_key = key;
+
+        switch (tail->position) {
+        case BUDGIE_PLACEMENT_EDGE_LEFT:
+        case BUDGIE_PLACEMENT_EDGE_RIGHT:
+                tail_centre = tail->y + tail->y_offset - alloc->y;
+                break;
+        default:
+                tail_centre = tail->x + tail->x_offset - alloc->x;
+                break;
+        }
+
+        /* Build it from slices, and only rasterise when we really can't */
+        cr = cairo_create(self->priv->chrome);
+        if (!budgie_chrome_slices_compose(self->priv->slices,
+                                          window,
+                                          cr,
+                                          (GtkPositionType)tail->position,
+                                          alloc->width,
+                                          alloc->height,
+                                          tail_centre)) {
+                cairo_translate(cr, -alloc->x, -alloc->y);
+                budgie_popover_render_chrome(self, cr, alloc, tail);
+        }
+        cairo_destroy(cr);
+
+        return self->priv->chrome;
+}
+
+/**
+ * Override the drawing to provide a tail region
+ */
+static gboolean budgie_popover_draw(GtkWidget *widget, cairo_t *cr)
+{
+        GtkAllocation alloc = { 0 };
+        GtkAllocation child_alloc = { 0 };
+        GdkRectangle clip = { 0 };
+        GtkWidget *child = NULL;
+        BudgiePopover *self = NULL;
+        cairo_surface_t *chrome = NULL;
+        gint64 start = g_get_monotonic_time();
+
+        self = BUDGIE_POPOVER(widget);
+        gtk_widget_get_allocation(widget, &alloc);
+
+        /* Nothing was damaged */
+        if (!gdk_cairo_get_clip_rectangle(cr, &clip)) {
+                return GDK_EVENT_STOP;
+        }
+        budgie_stats_add(&self->priv->stats,
+                         BUDGIE_STATS_PIXELS,
+                         (guint64)clip.width * (guint64)clip.height);
+
+        chrome = budgie_popover_get_chrome(self, &alloc);
+
+        /* Chrome already carries its own transparency, so just copy it */
+        cairo_save(cr);
+        cairo_set_operator(cr, CAIRO_OPERATOR_SOURCE);
+        cairo_set_source_surface(cr, chrome, alloc.x, alloc.y);
+        cairo_paint(cr);
+        cairo_restore(cr);
+
+        /* Only descend into the content if it was damaged too */
+        child = gtk_bin_get_child(GTK_BIN(widget));
+        if (child) {
+                gtk_widget_get_allocation(child, &child_alloc);
+                if (gdk_rectangle_intersect(&clip, &child_alloc, NULL)) {
+                        gtk_container_propagate_draw(GTK_CONTAINER(widget), child, cr);
+                }
+        }
+
+        budgie_stats_count(&self->priv->stats, BUDGIE_STATS_REDRAWS);
+        budgie_stats_record(&self->priv->stats, BUDGIE_STATS_DRAW, g_get_monotonic_time() - start);
+        if (self->priv->show_start > 0) {
+                budgie_stats_record(&self->priv->stats,
+                                    BUDGIE_STATS_SHOW,
+                                    g_get_monotonic_time() - self->priv->show_start);
+                self->priv->show_start = 0;
+        }
 
         return GDK_EVENT_STOP;
 }
 
+/**
+ * Theme changed, so our cached chrome is no longer valid
+ */
+static void budgie_popover_style_updated(GtkWidget *widget)
+{
+        BudgiePopover *self = BUDGIE_POPOVER(widget);
+
+        self->priv->style_serial++;
+        GTK_WIDGET_CLASS(budgie_popover_parent_class)->style_updated(widget);
+}
+
+/**
+ * Cached chrome and slices are similar to our GdkWindow, so can't outlive it
+ */
+static void budgie_popover_realize(GtkWidget *widget)
+{
+        BudgiePopover *self = BUDGIE_POPOVER(widget);
+
+        GTK_WIDGET_CLASS(budgie_popover_parent_class)->realize(widget);
+        if (self->priv->manager) {
+                budgie_popover_manager_popover_realized(self->priv->manager, self);
+        }
+}
+
+static void budgie_popover_unrealize(GtkWidget *widget)
+{
+        BudgiePopover *self = BUDGIE_POPOVER(widget);
+
+        g_clear_pointer(&self->priv->chrome, cairo_surface_destroy);
+        self->priv->speculated = FALSE;
+
+        /* A new GdkWindow won't carry our frame extents, so work them out again */
+        g_clear_pointer(&self->priv->input_shape, cairo_region_destroy);
+        memset(&self->priv->shadow_width, 0, sizeof(self->priv->shadow_width));
+
+        budgie_chrome_slices_invalidate(self->priv->slices, 0, 0);
+        self->priv->slices_serial = 0;
+        GTK_WIDGET_CLASS(budgie_popover_parent_class)->unrealize(widget);
+        if (self->priv->manager) {
+                budgie_popover_manager_popover_unrealized(self->priv->manager, self);
+        }
+}
+
 static void budgie_popover_add(GtkContainer *container, GtkWidget *widget)
 {
         BudgiePopover *self = NULL;
@@ -823,45 +1718,41 @@ static gboolean budgie_popover_hide_self(gpointer v)
 /**
  * If the mouse button is pressed outside of our window, that's our cue to close.
  */
-static gboolean budgie_popover_button_press(GtkWidget *widget, GdkEventButton *button,
-                                            __budgie_unused__ gpointer udata)
+static gboolean budgie_popover_button_press(GtkWidget *widget, GdkEventButton *button)
 {
-        gint x, y = 0;
-        gint w, h = 0;
-        gtk_window_get_position(GTK_WINDOW(widget), &x, &y);
-        gtk_window_get_size(GTK_WINDOW(widget), &w, &h);
-
-        gint root_x = (gint)button->x_root;
-        gint root_y = (gint)button->y_root;
-
-        /* Inside our window? Continue as normal. */
-        if ((root_x >= x && root_x <= x + w) && (root_y >= y && root_y <= y + h)) {
-                return GDK_EVENT_PROPAGATE;
+        /* Happened outside of our body and tail, so we're done. Hold a ref in
+         * case we're destroyed first. */
+        if (!budgie_popover_contains_point(BUDGIE_POPOVER(widget),
+                                           (gint)button->x_root,
+                                           (gint)button->y_root)) {
+                g_idle_add_full(G_PRIORITY_DEFAULT_IDLE,
+                                budgie_popover_hide_self,
+                                g_object_ref(widget),
+                                g_object_unref);
         }
 
-        /* Happened outside, we're done. */
-        g_idle_add(budgie_popover_hide_self, widget);
-        return GDK_EVENT_PROPAGATE;
+        return GTK_WIDGET_CLASS(budgie_popover_parent_class)->button_press_event(widget, button);
 }
 
 /**
  * If the Escape key is pressed, then we also need to close.
  */
-static gboolean budgie_popover_key_press(GtkWidget *widget, GdkEventKey *key,
-                                         __budgie_unused__ gpointer udata)
+static gboolean budgie_popover_key_press(GtkWidget *widget, GdkEventKey *key)
 {
         if (key->keyval == GDK_KEY_Escape) {
                 gtk_widget_hide(widget);
                 return GDK_EVENT_STOP;
         }
-        return GDK_EVENT_PROPAGATE;
+        return GTK_WIDGET_CLASS(budgie_popover_parent_class)->key_press_event(widget, key);
 }
 
 /**
  * Our associated widget has died, so we must unref ourselves now.
  */
-static void budgie_popover_disconnect(__budgie_unused__ GtkWidget *relative_to, BudgiePopover *self)
+static void budgie_popover_disconnect(GtkWidget *relative_to, BudgiePopover *self)
 {
+        budgie_geometry_cache_untrack(relative_to);
+        budgie_popover_watch_toplevel(self, NULL);
         self->priv->relative_to = NULL;
         gtk_widget_destroy(GTK_WIDGET(self));
 }
@@ -875,9 +1766,12 @@ static void budgie_popover_set_property(GObject *object, guint id, const GValue
         case PROP_RELATIVE_TO:
                 if (self->priv->relative_to) {
                         g_signal_handlers_disconnect_by_data(self->priv->relative_to, self);
+                        budgie_geometry_cache_untrack(self->priv->relative_to);
                 }
+                budgie_popover_watch_toplevel(self, NULL);
                 self->priv->relative_to = g_value_get_object(value);
                 if (self->priv->relative_to) {
+                        budgie_geometry_cache_track(self->priv->relative_to);
                         g_signal_connect(self->priv->relative_to,
                                          "destroy",
                                          G_CALLBACK(budgie_popover_disconnect),
@@ -905,6 +1799,9 @@ static void budgie_popover_get_property(GObject *object, guint id, GValue *value
         case PROP_POLICY:
                 g_value_set_enum(value, self->priv->policy);
                 break;
+        case PROP_RENDER_MODE:
+                g_value_set_enum(value, self->priv->render_mode);
+                break;
         default:
                 G_OBJECT_WARN_INVALID_PROPERTY_ID(object, id, spec);
                 break;
@@ -950,6 +1847,254 @@ GtkWidget *budgie_popover_new(GtkWidget *relative_to)
                             NULL);
 }
 
+/**
+ * budgie_popover_prepare:
+ *
+ * Do the expensive parts of the first show ahead of time, i.e. realizing the
+ * window, resolving our style, measuring the content and working out our
+ * placement. Hidden popovers may be unrealized again to release these resources.
+ */
+void budgie_popover_prepare(BudgiePopover *self)
+{
+        GtkRequisition req = { 0 };
+        BudgiePlacement placement = { 0 };
+
+        g_return_if_fail(self != NULL);
+
+        if (gtk_widget_get_visible(GTK_WIDGET(self))) {
+                return;
+        }
+
+        gtk_widget_realize(GTK_WIDGET(self));
+        budgie_popover_ensure_slices(self);
+        gtk_widget_get_preferred_size(GTK_WIDGET(self), NULL, &req);
+
+        /* Primes the placement memo for the upcoming map */
+        if (self->priv->relative_to) {
+                budgie_popover_compute_positition(self, &placement);
+        }
+}
+
+/**
+ * budgie_popover_speculate:
+ *
+ * Go one step further than budgie_popover_prepare() by also applying our
+ * placement and rendering the chrome for it, so that a show which follows
+ * shortly after only has to map the window. Everything is stored in the same
+ * caches that the show consults anyway, so a wrong guess costs nothing more
+ * to throw away than being overwritten.
+ */
+void budgie_popover_speculate(BudgiePopover *self)
+{
+        GtkRequisition req = { 0 };
+        GtkAllocation alloc = { 0 };
+        BudgiePlacement placement = { 0 };
+
+        g_return_if_fail(self != NULL);
+
+        if (gtk_widget_get_visible(GTK_WIDGET(self)) || !self->priv->relative_to) {
+                return;
+        }
+
+        gtk_widget_realize(GTK_WIDGET(self));
+        budgie_popover_ensure_slices(self);
+        gtk_widget_get_preferred_size(GTK_WIDGET(self), NULL, &req);
+
+        budgie_popover_compute_positition(self, &placement);
+        budgie_popover_apply_placement(self, &placement);
+
+        /* Size that the window will be given when it is shown */
+        gtk_window_get_size(GTK_WINDOW(self), &alloc.width, &alloc.height);
+        budgie_popover_get_chrome(self, &alloc);
+
+        self->priv->speculation = placement;
+        self->priv->speculated = TRUE;
+        budgie_stats_count(&self->priv->stats, BUDGIE_STATS_SPECULATIONS);
+}
+
+/**
+ * Find out whether the speculation from budgie_popover_speculate() still
+ * holds for the @placement we're actually being shown with. It's used up
+ * either way.
+ */
+static void budgie_popover_check_speculation(BudgiePopover *self, BudgiePlacement *placement)
+{
+        BudgiePlacement *guess = &(self->priv->speculation);
+        BudgieChromeKey *key = &(self->priv->chrome_key);
+        gint width, height = 0;
+        gboolean hit = FALSE;
+
+        if (!self->priv->speculated) {
+                return;
+        }
+        self->priv->speculated = FALSE;
+
+        /* Compared field by field as BudgieTail has padding */
+        gtk_window_get_size(GTK_WINDOW(self), &width, &height);
+        hit = self->priv->chrome != NULL && key->width == width && key->height == height &&
+              guess->x == placement->x && guess->y == placement->y &&
+              guess->tail.position == placement->tail.position &&
+              guess->tail.x_offset == placement->tail.x_offset &&
+              guess->tail.y_offset == placement->tail.y_offset;
+
+        budgie_stats_count(&self->priv->stats,
+                           hit ? BUDGIE_STATS_SPECULATION_HITS : BUDGIE_STATS_SPECULATION_MISSES);
+}
+
+/**
+ * budgie_popover_set_managed_grab:
+ *
+ * When @managed is TRUE the popover no longer grabs or releases the seat
+ * itself, leaving that to the owner (i.e. BudgiePopoverManager), which may
+ * then hand a single grab between popovers.
+ *
+ * @managed: Whether the seat grab is managed externally
+ */
+void budgie_popover_set_managed_grab(BudgiePopover *self, gboolean managed)
+{
+        g_return_if_fail(self != NULL);
+        self->priv->managed_grab = managed;
+}
+
+/**
+ * budgie_popover_set_manager:
+ *
+ * Internal API for BudgiePopoverManager. The manager is called directly on
+ * map, unmap, realize, unrealize, grab-broken and destroy until it unsets itself again.
+ * In turn it tells us about compositor and toplevel style changes, so we stop
+ * listening for those ourselves.
+ *
+ * @manager: (allow-none): Manager to report to, or NULL to stop
+ */
+void budgie_popover_set_manager(BudgiePopover *self, BudgiePopoverManager *manager)
+{
+        g_return_if_fail(self != NULL);
+
+        if (!self->priv->manager == !manager) {
+                self->priv->manager = manager;
+                return;
+        }
+
+        /* Watched again as needed on the next placement */
+        budgie_popover_watch_toplevel(self, NULL);
+        self->priv->manager = manager;
+
+        /* Our manager lets go of us as we're destroyed, and we're done by then */
+        if (gtk_widget_in_destruction(GTK_WIDGET(self))) {
+                return;
+        }
+        budgie_popover_watch_screen(self, manager == NULL);
+
+        /* Anything we missed in between is picked up now */
+        budgie_popover_update_render_mode(self);
+}
+
+/**
+ * budgie_popover_set_show_start:
+ *
+ * Internal API for BudgiePopoverManager, which queues our shows. The show
+ * latency recorded for our next show then runs from @requested rather than
+ * from when the queued show got around to us.
+ *
+ * @requested: Monotonic time that the show was requested
+ */
+void budgie_popover_set_show_start(BudgiePopover *self, gint64 requested)
+{
+        g_return_if_fail(self != NULL);
+        self->priv->show_requested = requested;
+}
+
+/**
+ * budgie_popover_composited_changed:
+ *
+ * Internal API for BudgiePopoverManager, which follows the compositor on
+ * behalf of all of its popovers
+ */
+void budgie_popover_composited_changed(BudgiePopover *self)
+{
+        g_return_if_fail(self != NULL);
+        budgie_popover_update_render_mode(self);
+}
+
+/**
+ * budgie_popover_toplevel_style_changed:
+ *
+ * Internal API for BudgiePopoverManager, which watches each toplevel once on
+ * behalf of all of its popovers. Only matters if @toplevel is the one holding
+ * our relative_to widget.
+ *
+ * @toplevel: Toplevel whose style was updated
+ */
+void budgie_popover_toplevel_style_changed(BudgiePopover *self, GtkWidget *toplevel)
+{
+        g_return_if_fail(self != NULL);
+        if (self->priv->hint_toplevel == toplevel) {
+                self->priv->toplevel_edge_valid = FALSE;
+        }
+}
+
+/**
+ * budgie_popover_get_render_mode:
+ *
+ * Determine whether the popover is rendering translucent, shadowed chrome or
+ * has fallen back to the cheaper opaque mode for a non-composited screen
+ *
+ * Returns: The #BudgiePopoverRenderMode currently in use
+ */
+BudgiePopoverRenderMode budgie_popover_get_render_mode(BudgiePopover *self)
+{
+        g_return_val_if_fail(self != NULL, 0);
+        return self->priv->render_mode;
+}
+
+/**
+ * budgie_popover_contains_point:
+ *
+ * Determine whether the given screen coordinates fall on the visible body or
+ * tail of the popover. This is answered from our cached on-screen geometry
+ * and input shape, without asking the display server.
+ *
+ * @root_x: X coordinate relative to the root window
+ * @root_y: Y coordinate relative to the root window
+ */
+gboolean budgie_popover_contains_point(BudgiePopover *self, gint root_x, gint root_y)
+{
+        GdkRectangle rect = { 0 };
+
+        g_return_val_if_fail(self != NULL, FALSE);
+
+        if (self->priv->screen_rect_valid) {
+                rect = self->priv->screen_rect;
+        } else {
+                /* Not on screen, so we have to ask where we would be */
+                budgie_stats_count(&self->priv->stats, BUDGIE_STATS_GEOMETRY_QUERIES);
+                gtk_window_get_position(GTK_WINDOW(self), &rect.x, &rect.y);
+                gtk_window_get_size(GTK_WINDOW(self), &rect.width, &rect.height);
+        }
+
+        root_x -= rect.x;
+        root_y -= rect.y;
+
+        if (self->priv->input_shape) {
+                return cairo_region_contains_point(self->priv->input_shape, root_x, root_y);
+        }
+        return root_x >= 0 && root_x <= rect.width && root_y >= 0 && root_y <= rect.height;
+}
+
+/**
+ * budgie_popover_get_stats:
+ *
+ * Retrieve the performance statistics for this popover. Recording is always
+ * enabled, and the statistics live for as long as the popover does.
+ *
+ * Returns: (transfer none): The statistics for this popover
+ */
+const BudgieStats *budgie_popover_get_stats(BudgiePopover *self)
+{
+        g_return_val_if_fail(self != NULL, NULL);
+        return &(self->priv->stats);
+}
+
 /**
  * budgie_popover_set_position_policy:
  *
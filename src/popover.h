@@ -14,6 +14,8 @@
 #include <glib-object.h>
 #include <gtk/gtk.h>
 
+#include "popover-stats.h"
+
 G_BEGIN_DECLS
 
 typedef struct _BudgiePopover BudgiePopover;
@@ -48,6 +50,21 @@ typedef enum {
         BUDGIE_POPOVER_POSITION_TOPLEVEL_HINT,
 } BudgiePopoverPositionPolicy;
 
+/**
+ * BudgiePopoverRenderMode:
+ * @BUDGIE_POPOVER_RENDER_COMPOSITED: Translucent chrome with a shadow, on an RGBA visual
+ * @BUDGIE_POPOVER_RENDER_OPAQUE: Opaque chrome on a window shaped to the body and tail
+ *
+ * The BudgiePopoverRenderMode is picked automatically, depending on whether
+ * the screen is composited and offers an RGBA visual. The opaque mode avoids
+ * the alpha blending, shadow margin and subpixel antialiasing that are
+ * expensive on software rendered or non-composited sessions.
+ */
+typedef enum {
+        BUDGIE_POPOVER_RENDER_COMPOSITED = 0,
+        BUDGIE_POPOVER_RENDER_OPAQUE,
+} BudgiePopoverRenderMode;
+
 #define BUDGIE_TYPE_POPOVER budgie_popover_get_type()
 #define BUDGIE_POPOVER(o) (G_TYPE_CHECK_INSTANCE_CAST((o), BUDGIE_TYPE_POPOVER, BudgiePopover))
 #define BUDGIE_IS_POPOVER(o) (G_TYPE_CHECK_INSTANCE_TYPE((o), BUDGIE_TYPE_POPOVER))
@@ -66,6 +83,13 @@ GtkWidget *budgie_popover_new(GtkWidget *relative_to);
 void budgie_popover_set_position_policy(BudgiePopover *popover, BudgiePopoverPositionPolicy policy);
 BudgiePopoverPositionPolicy budgie_popover_get_position_policy(BudgiePopover *popover);
 
+void budgie_popover_prepare(BudgiePopover *popover);
+void budgie_popover_speculate(BudgiePopover *popover);
+void budgie_popover_set_managed_grab(BudgiePopover *popover, gboolean managed);
+const BudgieStats *budgie_popover_get_stats(BudgiePopover *popover);
+gboolean budgie_popover_contains_point(BudgiePopover *popover, gint root_x, gint root_y);
+BudgiePopoverRenderMode budgie_popover_get_render_mode(BudgiePopover *popover);
+
 GType budgie_popover_get_type(void);
 
 G_END_DECLS